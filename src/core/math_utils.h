@@ -46,27 +46,74 @@ inline Vec3 RandomVec3(double min, double max) {
   );
 }
 
+// -----------------------------------------------------------------------------
+// Closed-form warps from [0,1)^2
+//   Branch-free (selects only), one sample in -> one point out, so they work
+//   with stratified / sobol samples and vectorize. Per-lane versions of the
+//   batched functions further down.
+// -----------------------------------------------------------------------------
+
+// Concentric map to the unit disk (Shirley & Chiu), z = 0
+inline Vec3 SampleConcentricDisk(double u1, double u2) {
+  const double a = 2.0 * u1 - 1.0;
+  const double b = 2.0 * u2 - 1.0;
+
+  const bool   use_a   = std::fabs(a) > std::fabs(b);
+  const double safe_a  = (a != 0.0) ? a : 1.0;
+  const double safe_b  = (b != 0.0) ? b : 1.0;
+  const double r       = use_a ? a : b;
+  const double phi     = use_a ? (0.25 * kPi) * (b / safe_a)
+                               : (0.5 * kPi) - (0.25 * kPi) * (a / safe_b);
+
+  return Vec3(r * std::cos(phi), r * std::sin(phi), 0.0);
+}
+
+// Uniform direction on the unit sphere, pdf = 1 / (4 pi)
+inline Vec3 SampleUniformSphere(double u1, double u2) {
+  const double z   = 1.0 - 2.0 * u1;
+  const double r   = std::sqrt(std::fmax(0.0, 1.0 - z * z));
+  const double phi = kTwoPi * u2;
+  return Vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+// Uniform point inside the unit ball
+inline Vec3 SampleUniformBall(double u1, double u2, double u3) {
+  return std::cbrt(u3) * SampleUniformSphere(u1, u2);
+}
+
+// Cosine-weighted direction about +z (Malley's method), pdf = cos(theta) / pi
+inline Vec3 SampleCosineHemisphere(double u1, double u2) {
+  const Vec3 d = SampleConcentricDisk(u1, u2);
+  const double z = std::sqrt(std::fmax(0.0, 1.0 - d.x() * d.x() - d.y() * d.y()));
+  return Vec3(d.x(), d.y(), z);
+}
+
+// -----------------------------------------------------------------------------
+// Orthonormal basis around a unit vector n, branch-free
+//   (Duff et al., "Building an Orthonormal Basis, Revisited", JCGT 2017)
+// -----------------------------------------------------------------------------
+inline void BuildOrthonormalBasis(const Vec3& n, Vec3& t, Vec3& b) {
+  const double sign = std::copysign(1.0, n.z());
+  const double a = -1.0 / (sign + n.z());
+  const double c = n.x() * n.y() * a;
+  t = Vec3(1.0 + sign * n.x() * n.x() * a, sign * c, -sign * n.x());
+  b = Vec3(c, sign + n.y() * n.y() * a, -n.y());
+}
+
 // -----------------------------------------------------------------------------
 // Uniform Random Point in Unit Sphere
 // -----------------------------------------------------------------------------
 inline Vec3 RandomInUnitSphere() {
-  while (true) {
-    Vec3 p = RandomVec3(-1.0, 1.0);
-    if (p.length_squared() < 1.0) return p;
-  }
+  const Sample2D xi = Random2D();
+  return SampleUniformBall(xi.u, xi.v, RandomDouble());
 }
 
 // -----------------------------------------------------------------------------
 // Random Unit Vector (uniform direction on sphere)
 // -----------------------------------------------------------------------------
 inline Vec3 RandomUnitVector() {
-  while (true) {
-    Vec3 p = RandomVec3(-1.0, 1.0);
-    const double len_sq = p.length_squared();
-    if (len_sq > 1e-12 && len_sq <= 1.0) {
-      return p / std::sqrt(len_sq);
-    }
-  }
+  const Sample2D xi = Random2D();
+  return SampleUniformSphere(xi.u, xi.v);
 }
 
 // -----------------------------------------------------------------------------
@@ -81,10 +128,8 @@ inline Vec3 RandomOnHemisphere(const Vec3& normal) {
 // Random point in unit disk (for depth of field sampling)
 // -----------------------------------------------------------------------------
 inline Vec3 RandomInUnitDisk() {
-  while (true) {
-    Vec3 p(RandomDouble(-1, 1), RandomDouble(-1, 1), 0.0);
-    if (p.length_squared() < 1.0) return p;
-  }
+  const Sample2D xi = Random2D();
+  return SampleConcentricDisk(xi.u, xi.v);
 }
 
 // -----------------------------------------------------------------------------
@@ -102,24 +147,79 @@ inline Vec3 Normalize(const Vec3& v) {
 //   Used for Lambertian importance sampling and NEE
 // -----------------------------------------------------------------------------
 inline Vec3 RandomCosineDirection(const Vec3& normal) {
-  // Sample r1, r2 from U(0,1)
-  double r1 = RandomDouble();
-  double r2 = RandomDouble();
-
-  // Convert to polar coordinates
-  double phi = 2.0 * kPi * r1;
-  double r   = std::sqrt(r2);
-  double x   = r * std::cos(phi);
-  double y   = r * std::sin(phi);
-  double z   = std::sqrt(1.0 - r2);
+  const Sample2D xi = Random2D();
+  const Vec3 local = SampleCosineHemisphere(xi.u, xi.v);
 
   // Create local ONB: w = normal
   Vec3 w = Normalize(normal);
-  Vec3 a = (std::fabs(w.x()) > 0.9) ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
-  Vec3 v = Normalize(Cross(w, a));
-  Vec3 u = Cross(v, w);
+  Vec3 u, v;
+  BuildOrthonormalBasis(w, u, v);
+
+  return local.x() * u + local.y() * v + local.z() * w;
+}
+
+// -----------------------------------------------------------------------------
+// Batched warps (structure of arrays)
+//   The same mappings as above over n samples at once, written so the
+//   compiler can vectorize them (omp simd, no branches, no early exits).
+//   Inputs are [0,1) samples; outputs may not alias inputs.
+// -----------------------------------------------------------------------------
+inline void SampleConcentricDiskBatch(const double* u1, const double* u2,
+                                      double* x, double* y, int n) {
+  #pragma omp simd
+  for (int i = 0; i < n; ++i) {
+    const double a = 2.0 * u1[i] - 1.0;
+    const double b = 2.0 * u2[i] - 1.0;
 
-  return Normalize(x * u + y * v + z * w);
+    const bool   use_a  = std::fabs(a) > std::fabs(b);
+    const double safe_a = (a != 0.0) ? a : 1.0;
+    const double safe_b = (b != 0.0) ? b : 1.0;
+    const double r      = use_a ? a : b;
+    const double phi    = use_a ? (0.25 * kPi) * (b / safe_a)
+                                : (0.5 * kPi) - (0.25 * kPi) * (a / safe_b);
+
+    x[i] = r * std::cos(phi);
+    y[i] = r * std::sin(phi);
+  }
+}
+
+inline void SampleUniformSphereBatch(const double* u1, const double* u2,
+                                     double* x, double* y, double* z, int n) {
+  #pragma omp simd
+  for (int i = 0; i < n; ++i) {
+    const double zi  = 1.0 - 2.0 * u1[i];
+    const double r   = std::sqrt(std::fmax(0.0, 1.0 - zi * zi));
+    const double phi = kTwoPi * u2[i];
+    x[i] = r * std::cos(phi);
+    y[i] = r * std::sin(phi);
+    z[i] = zi;
+  }
+}
+
+// cosine-weighted directions about the per-lane normals (nx, ny, nz),
+// written to world space
+inline void SampleCosineDirectionBatch(const double* u1, const double* u2,
+                                       const double* nx, const double* ny, const double* nz,
+                                       double* x, double* y, double* z, int n) {
+  SampleConcentricDiskBatch(u1, u2, x, y, n);
+
+  #pragma omp simd
+  for (int i = 0; i < n; ++i) {
+    const double lx = x[i];
+    const double ly = y[i];
+    const double lz = std::sqrt(std::fmax(0.0, 1.0 - lx * lx - ly * ly));
+
+    // branch-free basis around the normal
+    const double sign = std::copysign(1.0, nz[i]);
+    const double a = -1.0 / (sign + nz[i]);
+    const double c = nx[i] * ny[i] * a;
+    const double tx = 1.0 + sign * nx[i] * nx[i] * a, ty = sign * c, tz = -sign * nx[i];
+    const double bx = c, by = sign + ny[i] * ny[i] * a, bz = -ny[i];
+
+    x[i] = lx * tx + ly * bx + lz * nx[i];
+    y[i] = lx * ty + ly * by + lz * ny[i];
+    z[i] = lx * tz + ly * bz + lz * nz[i];
+  }
 }
 
 }  // namespace rt::core
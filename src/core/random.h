@@ -1,27 +1,166 @@
 #pragma once
 
+#include "sobol.h"
+
+#include <atomic>
+#include <cstdint>
 #include <random>
+#include <string>
 
 namespace rt::core {
 
 // -----------------------------------------------------------------------------
-// THREAD-LOCAL RANDOM ENGINE
+// COUNTER-BASED RANDOM NUMBERS
 //
-// Each thread gets its own RNG so that parallel rendering (OpenMP, TBB, std::thread)
-// does not cause contention or correlation.
+// Every random number is a pure hash of (seed, pixel, sample, bounce, dimension),
+// so a path draws the same numbers no matter which thread traces it, in which
+// order, or how many threads there are. The renderers key a stream per path
+// vertex; each RandomDouble() call advances the dimension.
 // -----------------------------------------------------------------------------
 
-inline std::mt19937& GetRng() {
-  thread_local static std::mt19937 rng(std::random_device{}());
+// splitmix64 finalizer
+inline uint64_t Mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+// key for one path vertex
+inline uint64_t SampleKey(uint32_t pixel, uint32_t sample, uint32_t bounce, uint64_t seed = 0) {
+  uint64_t k = Mix64(seed + 0x9e3779b97f4a7c15ull);
+  k = Mix64(k ^ (uint64_t(pixel) | (uint64_t(sample) << 32)));
+  return Mix64(k ^ bounce);
+}
+
+// 32 random bits for dimension dim of a keyed stream
+inline uint32_t HashBits(uint64_t key, uint32_t dim) {
+  return static_cast<uint32_t>(Mix64(key + (uint64_t(dim) + 1) * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+// uniform double in [0, 1) for dimension dim of a keyed stream
+inline double HashUniform(uint64_t key, uint32_t dim) {
+  return HashBits(key, dim) * 0x1p-32;
+}
+
+// how a keyed stream turns dimensions into numbers
+//   kIndependent: every dimension is an independent hash
+//   kSobol:       Owen-scrambled Sobol points across the samples of a pixel
+enum class SampleMode {
+  kIndependent,
+  kSobol,
+};
+
+// "independent" or "sobol"; false for any other name, mode unchanged
+inline bool ParseSampleMode(const std::string& name, SampleMode& mode) {
+  if (name == "independent")
+    mode = SampleMode::kIndependent;
+  else if (name == "sobol")
+    mode = SampleMode::kSobol;
+  else
+    return false;
+  return true;
+}
+
+struct Sample2D {
+  double u;
+  double v;
+};
+
+class CounterRng {
+ public:
+  using result_type = uint32_t;
+
+  CounterRng() = default;
+  explicit CounterRng(uint64_t key) : key_(key), pattern_(key) {}
+  CounterRng(uint32_t pixel, uint32_t sample, uint32_t bounce,
+             SampleMode mode = SampleMode::kIndependent, uint64_t seed = 0)
+      : key_(SampleKey(pixel, sample, bounce, seed)),
+        pattern_(SampleKey(pixel, 0, bounce, seed)),
+        sample_(sample),
+        mode_(mode) {}
+
+  // UniformRandomBitGenerator interface, so std distributions still work
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT32_MAX; }
+  result_type operator()() { return HashBits(key_, dim_++); }
+
+  double Uniform() {
+    if (mode_ == SampleMode::kSobol) {
+      return SobolSample1D(sample_, HashBits(pattern_, dim_++));
+    }
+    return HashUniform(key_, dim_++);
+  }
+
+  // a 2D point; stratified jointly in sobol mode
+  Sample2D Next2D() {
+    if (mode_ == SampleMode::kSobol) {
+      Sample2D s;
+      SobolSample2D(sample_, HashBits(pattern_, dim_++), s.u, s.v);
+      return s;
+    }
+    double u = Uniform();
+    double v = Uniform();
+    return { u, v };
+  }
+
+  // batched draw of the next n independent dimensions
+  void Fill(double* out, int n) {
+    const uint64_t key = key_;
+    const uint32_t base = dim_;
+    #pragma omp simd
+    for (int i = 0; i < n; ++i) {
+      out[i] = HashUniform(key, base + i);
+    }
+    dim_ += n;
+  }
+
+  uint64_t key() const { return key_; }
+  uint32_t dimension() const { return dim_; }
+
+ private:
+  uint64_t key_ = 0;      // (pixel, sample, bounce)
+  uint64_t pattern_ = 0;  // (pixel, bounce), shared by all samples of a pixel
+  uint32_t sample_ = 0;
+  uint32_t dim_ = 0;
+  SampleMode mode_ = SampleMode::kIndependent;
+};
+
+// -----------------------------------------------------------------------------
+// THREAD-LOCAL STREAM
+//
+// The stream consumed by RandomDouble() and friends. Renderers install a keyed
+// stream with ScopedRng around each path vertex. Outside of that each thread
+// falls back to a stream keyed by the order threads first asked for one, which
+// keeps scene construction on the main thread deterministic.
+// -----------------------------------------------------------------------------
+
+inline CounterRng& GetRng() {
+  static std::atomic<uint32_t> next_thread{0};
+  thread_local static CounterRng rng(SampleKey(next_thread.fetch_add(1), 0, 0));
   return rng;
 }
 
+// installs a stream for the current scope, restores the previous one on exit
+class ScopedRng {
+ public:
+  explicit ScopedRng(const CounterRng& rng) : saved_(GetRng()) { GetRng() = rng; }
+  ~ScopedRng() { GetRng() = saved_; }
+
+  ScopedRng(const ScopedRng&) = delete;
+  ScopedRng& operator=(const ScopedRng&) = delete;
+
+ private:
+  CounterRng saved_;
+};
+
 // -----------------------------------------------------------------------------
 // Generate uniform double in [0, 1)
 // -----------------------------------------------------------------------------
 inline double RandomDouble() {
-  thread_local static std::uniform_real_distribution<double> dist(0.0, 1.0);
-  return dist(GetRng());
+  return GetRng().Uniform();
 }
 
 // -----------------------------------------------------------------------------
@@ -31,6 +170,22 @@ inline double RandomDouble(double min, double max) {
   return min + (max - min) * RandomDouble();
 }
 
+// -----------------------------------------------------------------------------
+// Generate a 2D sample in [0, 1)^2
+// Use this instead of two RandomDouble() calls for anything 2D (pixel offset,
+// lens, BSDF direction) so the sobol stream stratifies both axes together.
+// -----------------------------------------------------------------------------
+inline Sample2D Random2D() {
+  return GetRng().Next2D();
+}
+
+// -----------------------------------------------------------------------------
+// Fill out[0..n) with uniform doubles in [0, 1)
+// -----------------------------------------------------------------------------
+inline void RandomDoubles(double* out, int n) {
+  GetRng().Fill(out, n);
+}
+
 // -----------------------------------------------------------------------------
 // Generate uniform integer in [min, max]
 // -----------------------------------------------------------------------------
@@ -41,10 +196,10 @@ inline int RandomInt(int min, int max) {
 
 // -----------------------------------------------------------------------------
 // Seed control (optional)
-// Call this if you want deterministic rendering sequences.
+// Restarts the current thread's stream from a fixed seed.
 // -----------------------------------------------------------------------------
 inline void SeedRng(unsigned int seed) {
-  GetRng().seed(seed);
+  GetRng() = CounterRng(SampleKey(0, 0, 0, seed));
 }
 
 }  // namespace rt::core
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rt::core {
+
+// -----------------------------------------------------------------------------
+// OWEN-SCRAMBLED SOBOL POINTS
+//
+// Hash-based Owen scrambling of the first two Sobol dimensions
+// (Burley, "Practical Hash-based Owen Scrambling", JCGT 2020).
+// Higher dimensions are padded: every 2D draw gets its own scramble seed and a
+// scrambled (shuffled) sample index, which decorrelates dimension pairs while
+// keeping each pair a (0,2)-sequence per pixel.
+// -----------------------------------------------------------------------------
+
+inline uint32_t ReverseBits(uint32_t x) {
+  x = (x << 16) | (x >> 16);
+  x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+  x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+  x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+  x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+  return x;
+}
+
+// random permutation that only lets lower bits affect higher bits
+inline uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed) {
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+// Owen scramble: each bit flipped by a hash of the bits above it
+inline uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) {
+  x = ReverseBits(x);
+  x = LaineKarrasPermutation(x, seed);
+  return ReverseBits(x);
+}
+
+inline uint32_t HashCombine(uint32_t seed, uint32_t v) {
+  return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+// Sobol dimension 0 is the van der Corput sequence
+inline uint32_t SobolDim0(uint32_t index) {
+  return ReverseBits(index);
+}
+
+// Sobol dimension 1, primitive polynomial x + 1
+inline uint32_t SobolDim1(uint32_t index) {
+  uint32_t result = 0;
+  for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+    if (index & 1) result ^= v;
+  }
+  return result;
+}
+
+// scrambled 1D point in [0, 1)
+inline double SobolSample1D(uint32_t index, uint32_t seed) {
+  index = NestedUniformScramble(index, seed);
+  uint32_t x = NestedUniformScramble(SobolDim0(index), HashCombine(seed, 0));
+  return x * 0x1p-32;
+}
+
+// scrambled 2D point in [0, 1)^2
+inline void SobolSample2D(uint32_t index, uint32_t seed, double& u, double& v) {
+  index = NestedUniformScramble(index, seed);
+  uint32_t x = NestedUniformScramble(SobolDim0(index), HashCombine(seed, 0));
+  uint32_t y = NestedUniformScramble(SobolDim1(index), HashCombine(seed, 1));
+  u = x * 0x1p-32;
+  v = y * 0x1p-32;
+}
+
+}  // namespace rt::core
@@ -72,6 +72,18 @@ class Bvh : public Hittable {
         if (root_index_ < 0 || nodes_.empty())
             return false;
 
+        return Traverse(nodes_.data(), root_index_, prim_indices_.data(), r, ray_t, rec,
+            [this](int prim_idx, const core::Ray& ray, core::Interval t, HitRecord& out) {
+                return primitives_[prim_idx]->Hit(ray, t, out);
+            });
+    }
+
+    /// Closest hit over flattened nodes, hit_prim(prim_idx, ray, interval, rec)
+    /// tests one primitive. Also used on the nodes of mapped scene bundles.
+    template <class HitPrim>
+    static bool Traverse(const BvhNodeGPU* nodes, int root, const int* prim_indices,
+                         const core::Ray& r, core::Interval ray_t, HitRecord& rec,
+                         HitPrim&& hit_prim) {
         bool hit_anything = false;
         double closest = ray_t.max_;
         HitRecord temp_rec;
@@ -79,11 +91,11 @@ class Bvh : public Hittable {
         // Iterative traversal stack
         int stack[64];
         int sp = 0;
-        stack[sp++] = root_index_;
+        stack[sp++] = root;
 
         while (sp > 0) {
             int node_idx = stack[--sp];
-            const BvhNodeGPU& node = nodes_[node_idx];
+            const BvhNodeGPU& node = nodes[node_idx];
 
             core::Interval node_range(ray_t.min_, closest);
             if (!node.bbox.Hit(r, node_range))
@@ -95,9 +107,11 @@ class Bvh : public Hittable {
                 int count = static_cast<int>(node.right_pCnt);
 
                 for (int i = 0; i < count; ++i) {
-                    int prim_idx = prim_indices_[first + i];
-                    auto& obj   = primitives_[prim_idx];
-                    if (obj->Hit(r, core::Interval(ray_t.min_, closest), temp_rec)) {
+                    int prim_idx = prim_indices[first + i];
+                    if (hit_prim(prim_idx, r, core::Interval(ray_t.min_, closest), temp_rec)) {
+                        // nested Bvhs (mesh instances) write theirs first,
+                        // the outermost one has the last word
+                        temp_rec.prim_id = static_cast<uint32_t>(prim_idx);
                         hit_anything = true;
                         closest = temp_rec.t;
                         rec = temp_rec;
@@ -129,11 +143,23 @@ class Bvh : public Hittable {
     int ObjectIndex() const override { return -1; }
     void set_object_index(int) override {}
 
+    void BindMaterials(material::MaterialTable& table) override {
+        for (auto& prim : primitives_)
+            prim->BindMaterials(table);
+    }
+
+    // in build order, so a Bvh over the records splits the same way
+    void Record(PrimitiveList& list) const override {
+        for (const auto& prim : primitives_)
+            prim->Record(list);
+    }
+
     // ==== GPU-facing accessors ====
 
     const std::vector<BvhNodeGPU>& nodes() const { return nodes_; }
     const std::vector<int>&        prim_indices() const { return prim_indices_; }
     const std::vector<std::shared_ptr<Hittable>>& primitives() const { return primitives_; }
+    int root() const { return root_index_; }
 
   private:
     // === Internal build structures ===
@@ -6,21 +6,27 @@
 
 #include "aabb.h"
 
+#include <cstdint>
 #include <memory>
 
 // to solve circular references between material and hittable code
 namespace rt::material {
     class Material;
+    class MaterialTable;
 }
 
 namespace rt::geom {
 
+class PrimitiveList;
+
 class HitRecord {
 public:
     bool hit;
     core::Point3 p; // hit point
     core::Vec3 normal; // normal vector
-    std::shared_ptr<material::Material> mat;
+    const material::Material* mat = nullptr; // facade, owned by the primitive
+    uint32_t mat_id = 0; // index into the scene's MaterialTable
+    uint32_t prim_id = 0; // entry of the outermost Bvh that was hit, set by Bvh::Traverse
     double t; // time of hit
     bool front_face;
 
@@ -28,6 +34,11 @@ public:
     double u; 
     double v;
 
+    // uv change per world unit along the surface, for texture filtering
+    // 0 when the primitive has no uv parameterization
+    double dudp = 0.0;
+    double dvdp = 0.0;
+
     void set_face_normal(const core::Ray& r, const core::Vec3& outward_normal) {
         front_face = core::Dot(r.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
@@ -59,6 +70,14 @@ public:
     virtual int TypeId() const = 0;
     virtual int ObjectIndex() const = 0;
     virtual void set_object_index(int i) = 0;
+
+    // registers this object's materials and stores their table ids
+    // containers forward to their children
+    virtual void BindMaterials(material::MaterialTable& /*table*/) {}
+
+    // appends this object's primitives in plain-data form (scene bundles)
+    // containers forward to their children, after BindMaterials
+    virtual void Record(PrimitiveList&) const {}
 };
 
 } // namespace rt::geom
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "core/interval.h"
+#include "core/ray.h"
+#include "core/vec3.h"
+
+#include "hittable.h"
+#include "aabb.h"
+#include "primitive_record.h"
+#include "transform.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+
+namespace rt::geom {
+
+/// A shared object placed in the world by a transform.
+/// The object (usually a mesh Bvh) is built once and every instance only
+/// stores a transform, so repeated geometry costs no extra memory.
+class Instance : public Hittable {
+public:
+    Instance(std::shared_ptr<Hittable> object, const Transform& xform)
+        : object_(std::move(object)), xform_(xform), inv_(xform.Inverse())
+    {
+        // uv rates shrink with the average scale of the transform
+        uv_scale_ = 1.0 / std::cbrt(std::fabs(xform_.Determinant()));
+
+        // world box from the eight transformed corners
+        const Aabb box = object_->BoundingBox();
+        bbox_ = Aabb();
+        for (int i = 0; i < 8; ++i) {
+            core::Point3 corner(
+                (i & 1) ? box.x.max_ : box.x.min_,
+                (i & 2) ? box.y.max_ : box.y.min_,
+                (i & 4) ? box.z.max_ : box.z.min_);
+            core::Point3 p = xform_.Point(corner);
+            bbox_ = (i == 0) ? Aabb(p, p) : Aabb(bbox_, p);
+        }
+    }
+
+    bool Hit(const core::Ray& r, core::Interval ray_t, HitRecord& rec) const override {
+        // the object space direction is not renormalized, so t is the same
+        // in both spaces
+        core::Ray local(inv_.Point(r.origin()), inv_.Vector(r.direction()));
+        if (!object_->Hit(local, ray_t, rec))
+            return false;
+
+        // facing is preserved by the transform, only the vectors move
+        rec.p = r.at(rec.t);
+        rec.normal = core::Normalize(inv_.TransposedVector(rec.normal));
+        rec.dudp *= uv_scale_;
+        rec.dvdp *= uv_scale_;
+        return true;
+    }
+
+    Aabb BoundingBox() const override {
+        return bbox_;
+    }
+
+    // instances are CPU only
+    int TypeId() const override { return -1; }
+    int ObjectIndex() const override { return -1; }
+    void set_object_index(int) override {}
+
+    // shared objects register the same ids for every instance
+    void BindMaterials(material::MaterialTable& table) override {
+        object_->BindMaterials(table);
+    }
+
+    // instances are flattened: the object's primitives are recorded in
+    // world space
+    void Record(PrimitiveList& list) const override {
+        list.PushTransform(xform_);
+        object_->Record(list);
+        list.PopTransform();
+    }
+
+private:
+    std::shared_ptr<Hittable> object_;
+    Transform xform_;
+    Transform inv_;
+    double uv_scale_ = 1.0;
+    Aabb bbox_;
+};
+
+} // namespace rt::geom
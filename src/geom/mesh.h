@@ -35,6 +35,19 @@ public:
     virtual Aabb BoundingBox() const override {
         return tris.BoundingBox();
     }
+
+    // containers have no GPU type, their triangles do
+    virtual int TypeId() const override { return -1; }
+    virtual int ObjectIndex() const override { return -1; }
+    virtual void set_object_index(int) override {}
+
+    virtual void BindMaterials(material::MaterialTable& table) override {
+        tris.BindMaterials(table);
+    }
+
+    virtual void Record(PrimitiveList& list) const override {
+        tris.Record(list);
+    }
 };
 
 } // namespace rt::geom
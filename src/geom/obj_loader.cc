@@ -0,0 +1,66 @@
+#include "geom/obj_loader.h"
+
+#include <tiny_obj_loader.h>
+
+#include <array>
+#include <iostream>
+#include <vector>
+
+namespace rt::geom {
+
+std::shared_ptr<Mesh> LoadObj(
+    const std::string& filename,
+    std::shared_ptr<material::Material> mat,
+    double scale,
+    bool center
+) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
+        std::cerr << "ERROR: Could not load mesh '" << filename << "': " << warn << err << "\n";
+        return nullptr;
+    }
+
+    std::vector<core::Point3> vertices;
+    vertices.reserve(attrib.vertices.size() / 3);
+    for (size_t v = 0; v < attrib.vertices.size() / 3; ++v) {
+        vertices.emplace_back(attrib.vertices[3*v+0],
+                              attrib.vertices[3*v+1],
+                              attrib.vertices[3*v+2]);
+    }
+
+    std::vector<std::array<int,3>> indices;
+    for (const auto& shape : shapes) {
+        size_t index_offset = 0;
+        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); ++f) {
+            const int fv = shape.mesh.num_face_vertices[f];
+
+            // fan triangulation around the first corner
+            for (int k = 1; k + 1 < fv; ++k) {
+                indices.push_back({
+                    shape.mesh.indices[index_offset].vertex_index,
+                    shape.mesh.indices[index_offset + k].vertex_index,
+                    shape.mesh.indices[index_offset + k + 1].vertex_index
+                });
+            }
+            index_offset += fv;
+        }
+    }
+
+    core::Vec3 centroid(0, 0, 0);
+    if (center && !vertices.empty()) {
+        for (const auto& v : vertices)
+            centroid += v;
+        centroid /= double(vertices.size());
+    }
+
+    for (auto& v : vertices)
+        v = (v - centroid) * scale;
+
+    return std::make_shared<Mesh>(vertices, indices, mat);
+}
+
+} // namespace rt::geom
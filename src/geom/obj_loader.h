@@ -0,0 +1,25 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <memory>
+#include <string>
+
+namespace rt::material {
+    class Material;
+}
+
+namespace rt::geom {
+
+// Loads the triangles of an OBJ file (polygons are fan triangulated) into a
+// Mesh with one material. When center is set the mesh is moved so its
+// vertex centroid is at the origin; vertices are then multiplied by scale.
+// Returns nullptr and reports to std::cerr on failure.
+std::shared_ptr<Mesh> LoadObj(
+    const std::string& filename,
+    std::shared_ptr<material::Material> mat,
+    double scale = 1.0,
+    bool center = false
+);
+
+} // namespace rt::geom
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "core/vec3.h"
+
+#include "transform.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace rt::geom {
+
+// Plain-data form of the scene's primitives, written to and mapped from scene
+// bundles. The primitive classes append themselves through Hittable::Record().
+
+enum class PrimitiveType : uint32_t {
+    kSphere,
+    kXyRect,
+    kXzRect,
+    kYzRect,
+    kTriangle,
+};
+
+struct PrimitiveRecord {
+    PrimitiveType type = PrimitiveType::kSphere;
+    uint32_t mat_id = 0;     // MaterialTable id
+    uint32_t index[3] = {};  // triangle: vertex buffer indices
+    uint32_t pad = 0;
+    double   data[5] = {};   // sphere: center, radius; rect: a0, a1, b0, b1, k
+};
+
+static_assert(sizeof(PrimitiveRecord) == 64, "one record per cache line");
+
+// Collects records and a shared vertex buffer. Triangle corners are
+// deduplicated, so mesh triangles index one vertex each instead of storing
+// three copies. Objects under a transform (instances) are flattened to world
+// space.
+class PrimitiveList {
+public:
+    void AddSphere(const core::Point3& center, double radius, uint32_t mat_id) {
+        PrimitiveRecord r;
+        r.type = PrimitiveType::kSphere;
+        r.mat_id = mat_id;
+        const core::Point3 c = Point(center);
+        // exact for uniform scales, the average scale otherwise
+        if (!stack_.empty())
+            radius *= std::cbrt(std::fabs(stack_.back().Determinant()));
+        r.data[0] = c.x();
+        r.data[1] = c.y();
+        r.data[2] = c.z();
+        r.data[3] = radius;
+        records_.push_back(r);
+    }
+
+    // a0..a1, b0..b1 on the rect's two axes, k on the third
+    void AddRect(PrimitiveType type, double a0, double a1, double b0, double b1, double k, uint32_t mat_id) {
+        if (stack_.empty()) {
+            PrimitiveRecord r;
+            r.type = type;
+            r.mat_id = mat_id;
+            r.data[0] = a0; r.data[1] = a1;
+            r.data[2] = b0; r.data[3] = b1;
+            r.data[4] = k;
+            records_.push_back(r);
+            return;
+        }
+
+        // a transformed rect is no longer axis aligned, it becomes two triangles
+        auto corner = [&](double a, double b) {
+            if (type == PrimitiveType::kXyRect) return core::Point3(a, b, k);
+            if (type == PrimitiveType::kXzRect) return core::Point3(a, k, b);
+            return core::Point3(k, a, b);
+        };
+        AddTriangle(corner(a0, b0), corner(a1, b0), corner(a1, b1), mat_id);
+        AddTriangle(corner(a0, b0), corner(a1, b1), corner(a0, b1), mat_id);
+    }
+
+    void AddTriangle(const core::Point3& a, const core::Point3& b, const core::Point3& c, uint32_t mat_id) {
+        PrimitiveRecord r;
+        r.type = PrimitiveType::kTriangle;
+        r.mat_id = mat_id;
+        r.index[0] = Vertex(Point(a));
+        r.index[1] = Vertex(Point(b));
+        r.index[2] = Vertex(Point(c));
+        records_.push_back(r);
+    }
+
+    // applies to everything added until the matching PopTransform
+    void PushTransform(const Transform& xform) {
+        stack_.push_back(stack_.empty() ? xform : stack_.back() * xform);
+    }
+    void PopTransform() { stack_.pop_back(); }
+
+    const std::vector<PrimitiveRecord>& records() const { return records_; }
+    const std::vector<core::Point3>&    vertices() const { return vertices_; }
+
+private:
+    core::Point3 Point(const core::Point3& p) const {
+        return stack_.empty() ? p : stack_.back().Point(p);
+    }
+
+    uint32_t Vertex(const core::Point3& p) {
+        const double xyz[3] = { p.x(), p.y(), p.z() };
+        VertexKey key;
+        std::memcpy(key.bits, xyz, sizeof(xyz));
+
+        auto [it, inserted] = vertex_ids_.emplace(key, static_cast<uint32_t>(vertices_.size()));
+        if (inserted)
+            vertices_.push_back(p);
+        return it->second;
+    }
+
+    // bit patterns, so only identical coordinates merge
+    struct VertexKey {
+        uint64_t bits[3];
+        bool operator==(const VertexKey& o) const {
+            return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2];
+        }
+    };
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& k) const {
+            uint64_t h = k.bits[0] * 0x9E3779B97F4A7C15ull;
+            h ^= k.bits[1] + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2);
+            h ^= k.bits[2] + 0x85EBCA77C2B2AE63ull + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
+
+    std::vector<PrimitiveRecord> records_;
+    std::vector<core::Point3>    vertices_;
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertex_ids_;
+    std::vector<Transform> stack_;
+};
+
+} // namespace rt::geom
@@ -3,7 +3,10 @@
 #include "core/vec3.h"
 #include "core/interval.h"
 
+#include "material/material_table.h"
+
 #include "hittable.h"
+#include "primitive_record.h"
 #include "aabb.h"
 
 namespace rt::geom {
@@ -17,39 +20,58 @@ public:
         : mat_(mat), x0_(x0), x1_(x1), y0_(y0), y1_(y1), k_(k) {}
 
     bool Hit(const core::Ray& r, core::Interval ray_t, HitRecord& rec) const override {
-        auto t = (k_ - r.origin().z()) / r.direction().z();
+        if (!Intersect(x0_, x1_, y0_, y1_, k_, r, ray_t, rec))
+            return false;
+
+        rec.mat = mat_.get();
+        rec.mat_id = mat_id_;
+        return true;
+    }
+
+    // everything but the material, shared with the mapped scene bundle
+    static bool Intersect(double x0, double x1, double y0, double y1, double k,
+                          const core::Ray& r, core::Interval ray_t, HitRecord& rec) {
+        auto t = (k - r.origin().z()) / r.direction().z();
         if (!ray_t.Surrounds(t))
             return false;
 
         auto x = r.origin().x() + t * r.direction().x();
         auto y = r.origin().y() + t * r.direction().y();
 
-        if (x < x0_ || x > x1_ || y < y0_ || y > y1_)
+        if (x < x0 || x > x1 || y < y0 || y > y1)
             return false;
 
-        rec.u = (x - x0_) / (x1_ - x0_);
-        rec.v = (y - y0_) / (y1_ - y0_);
+        rec.u = (x - x0) / (x1 - x0);
+        rec.v = (y - y0) / (y1 - y0);
+        rec.dudp = 1.0 / (x1 - x0);
+        rec.dvdp = 1.0 / (y1 - y0);
         rec.t = t;
 
         core::Vec3 outward_normal = core::Vec3(0, 0, 1);
         rec.set_face_normal(r, outward_normal);
-        rec.mat = mat_;
         rec.p = r.at(t);
 
         return true;
     }
 
     Aabb BoundingBox() const override {
+        return Bounds(x0_, x1_, y0_, y1_, k_);
+    }
+
+    static Aabb Bounds(double x0, double x1, double y0, double y1, double k) {
         // add a small thickness to prevent zero-width box
-        return Aabb(core::Point3(x0_, y0_, k_ - 0.0001), core::Point3(x1_, y1_, k_ + 0.0001));
+        return Aabb(core::Point3(x0, y0, k - 0.0001), core::Point3(x1, y1, k + 0.0001));
     }
 
     int TypeId() const override { return HITTABLE_SQUARE; }
     int ObjectIndex() const override { return index_; }
     void set_object_index(int i) override { index_ = i; }
+    void BindMaterials(material::MaterialTable& table) override { mat_id_ = table.Add(mat_.get()); }
+    void Record(PrimitiveList& list) const override { list.AddRect(PrimitiveType::kXyRect, x0_, x1_, y0_, y1_, k_, mat_id_); }
 
 private:
     std::shared_ptr<material::Material> mat_;
+    uint32_t mat_id_ = 0;
     double x0_, x1_, y0_, y1_, k_;
     int index_;
 };
@@ -63,37 +85,57 @@ public:
         : mat_(mat), x0_(x0), x1_(x1), z0_(z0), z1_(z1), k_(k) {}
 
     bool Hit(const core::Ray& r, core::Interval ray_t, HitRecord& rec) const override {
-        auto t = (k_ - r.origin().y()) / r.direction().y();
+        if (!Intersect(x0_, x1_, z0_, z1_, k_, r, ray_t, rec))
+            return false;
+
+        rec.mat = mat_.get();
+        rec.mat_id = mat_id_;
+        return true;
+    }
+
+    // everything but the material, shared with the mapped scene bundle
+    static bool Intersect(double x0, double x1, double z0, double z1, double k,
+                          const core::Ray& r, core::Interval ray_t, HitRecord& rec) {
+        auto t = (k - r.origin().y()) / r.direction().y();
         if (!ray_t.Surrounds(t))
             return false;
 
         auto x = r.origin().x() + t * r.direction().x();
         auto z = r.origin().z() + t * r.direction().z();
-        if (x < x0_ || x > x1_ || z < z0_ || z > z1_)
+
+        if (x < x0 || x > x1 || z < z0 || z > z1)
             return false;
 
-        rec.u = (x - x0_) / (x1_ - x0_);
-        rec.v = (z - z0_) / (z1_ - z0_);
+        rec.u = (x - x0) / (x1 - x0);
+        rec.v = (z - z0) / (z1 - z0);
+        rec.dudp = 1.0 / (x1 - x0);
+        rec.dvdp = 1.0 / (z1 - z0);
         rec.t = t;
 
         core::Vec3 outward_normal = core::Vec3(0, 1, 0);
         rec.set_face_normal(r, outward_normal);
-        rec.mat = mat_;
         rec.p = r.at(t);
 
         return true;
     }
 
     Aabb BoundingBox() const override {
-        return Aabb(core::Point3(x0_, k_ - 0.0001, z0_), core::Point3(x1_, k_ + 0.0001, z1_));
+        return Bounds(x0_, x1_, z0_, z1_, k_);
+    }
+
+    static Aabb Bounds(double x0, double x1, double z0, double z1, double k) {
+        return Aabb(core::Point3(x0, k - 0.0001, z0), core::Point3(x1, k + 0.0001, z1));
     }
 
     int TypeId() const override { return HITTABLE_SQUARE; }
     int ObjectIndex() const override { return index_; }
     void set_object_index(int i) override { index_ = i; }
+    void BindMaterials(material::MaterialTable& table) override { mat_id_ = table.Add(mat_.get()); }
+    void Record(PrimitiveList& list) const override { list.AddRect(PrimitiveType::kXzRect, x0_, x1_, z0_, z1_, k_, mat_id_); }
 
 private:
     std::shared_ptr<material::Material> mat_;
+    uint32_t mat_id_ = 0;
     double x0_, x1_, z0_, z1_, k_;
     int index_;
 };
@@ -107,38 +149,57 @@ public:
         : mat_(mat), y0_(y0), y1_(y1), z0_(z0), z1_(z1), k_(k) {}
 
     bool Hit(const core::Ray& r, core::Interval ray_t, HitRecord& rec) const override {
-        auto t = (k_ - r.origin().x()) / r.direction().x();
+        if (!Intersect(y0_, y1_, z0_, z1_, k_, r, ray_t, rec))
+            return false;
+
+        rec.mat = mat_.get();
+        rec.mat_id = mat_id_;
+        return true;
+    }
+
+    // everything but the material, shared with the mapped scene bundle
+    static bool Intersect(double y0, double y1, double z0, double z1, double k,
+                          const core::Ray& r, core::Interval ray_t, HitRecord& rec) {
+        auto t = (k - r.origin().x()) / r.direction().x();
         if (!ray_t.Surrounds(t))
             return false;
 
         auto y = r.origin().y() + t * r.direction().y();
         auto z = r.origin().z() + t * r.direction().z();
 
-        if (y < y0_ || y > y1_ || z < z0_ || z > z1_)
+        if (y < y0 || y > y1 || z < z0 || z > z1)
             return false;
 
-        rec.u = (y - y0_) / (y1_ - y0_);
-        rec.v = (z - z0_) / (z1_ - z0_);
+        rec.u = (y - y0) / (y1 - y0);
+        rec.v = (z - z0) / (z1 - z0);
+        rec.dudp = 1.0 / (y1 - y0);
+        rec.dvdp = 1.0 / (z1 - z0);
         rec.t = t;
 
         core::Vec3 outward_normal = core::Vec3(1, 0, 0);
         rec.set_face_normal(r, outward_normal);
-        rec.mat = mat_;
         rec.p = r.at(t);
 
         return true;
     }
 
     Aabb BoundingBox() const override {
-        return Aabb(core::Point3(k_ - 0.0001, y0_, z0_), core::Point3(k_ + 0.0001, y1_, z1_));
+        return Bounds(y0_, y1_, z0_, z1_, k_);
+    }
+
+    static Aabb Bounds(double y0, double y1, double z0, double z1, double k) {
+        return Aabb(core::Point3(k - 0.0001, y0, z0), core::Point3(k + 0.0001, y1, z1));
     }
 
     int TypeId() const override { return HITTABLE_SQUARE; }
     int ObjectIndex() const override { return index_; }
     void set_object_index(int i) override { index_ = i; }
+    void BindMaterials(material::MaterialTable& table) override { mat_id_ = table.Add(mat_.get()); }
+    void Record(PrimitiveList& list) const override { list.AddRect(PrimitiveType::kYzRect, y0_, y1_, z0_, z1_, k_, mat_id_); }
 
 private:
     std::shared_ptr<material::Material> mat_;
+    uint32_t mat_id_ = 0;
     double y0_, y1_, z0_, z1_, k_;
     int index_;
 };
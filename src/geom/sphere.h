@@ -4,7 +4,10 @@
 #include "core/interval.h"
 #include "core/vec3.h"
 
+#include "material/material_table.h"
+
 #include "hittable.h"
+#include "primitive_record.h"
 
 #include <memory>
 
@@ -16,16 +19,32 @@ public:
 
     Sphere(const core::Point3& center, double radius, std::shared_ptr<material::Material> mat) 
             : center_(center), radius_(std::fmax(0,radius)), mat_(mat) {
+        bbox_ = Bounds(center, radius);
+    }
+
+    static Aabb Bounds(const core::Point3& center, double radius) {
         core::Vec3 radius_vec = core::Vec3(radius, radius, radius);
-        bbox_ = Aabb(core::Point3(center + radius_vec), core::Point3(center - radius_vec));
+        return Aabb(core::Point3(center + radius_vec), core::Point3(center - radius_vec));
     }
 
     virtual bool Hit(const core::Ray& r, core::Interval ray_t, HitRecord& rec) const override {
         //g_num_primitive_tests++;
-        core::Vec3 oc = center_ - r.origin();
+        if (!Intersect(center_, radius_, r, ray_t, rec)) {
+            return false;
+        }
+        rec.mat = mat_.get();
+        rec.mat_id = mat_id_;
+
+        return true;
+    }
+
+    // everything but the material, shared with the mapped scene bundle
+    static bool Intersect(const core::Point3& center, double radius,
+                          const core::Ray& r, core::Interval ray_t, HitRecord& rec) {
+        core::Vec3 oc = center - r.origin();
         auto a = r.direction().length_squared();
         auto h = Dot(r.direction(), oc);
-        auto c = oc.length_squared() - radius_*radius_;
+        auto c = oc.length_squared() - radius*radius;
 
         auto discriminant = h*h - a*c;
         if( discriminant < 0 ) {
@@ -46,10 +65,14 @@ public:
         // update hit record reference
         rec.t = root;
         rec.p = r.at(rec.t);
-        core::Vec3 outward_normal = (rec.p - center_) / radius_;
+        core::Vec3 outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
         get_sphere_uv(outward_normal, rec.u, rec.v);
-        rec.mat = mat_;
+
+        // u wraps a circle of radius r*sin(theta), v a half great circle
+        double sin_theta = std::sqrt(std::fmax(1e-6, 1.0 - outward_normal.y() * outward_normal.y()));
+        rec.dudp = 1.0 / (2 * core::kPi * radius * sin_theta);
+        rec.dvdp = 1.0 / (core::kPi * radius);
 
         return true;
     }
@@ -70,6 +93,14 @@ public:
         gpu_index = i;
     }
 
+    virtual void BindMaterials(material::MaterialTable& table) override {
+        mat_id_ = table.Add(mat_.get());
+    }
+
+    virtual void Record(PrimitiveList& list) const override {
+        list.AddSphere(center_, radius_, mat_id_);
+    }
+
     static void get_sphere_uv(const core::Point3& p, double& u, double& v) {
         auto theta = std::acos(-p.y());
         auto phi = std::atan2(-p.z(), p.x()) + core::kPi;
@@ -82,6 +113,7 @@ private:
     core::Point3 center_;
     double radius_;
     std::shared_ptr<material::Material> mat_;
+    uint32_t mat_id_ = 0;
     Aabb bbox_;
 };
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "core/math_utils.h"
+#include "material/material_table.h"
+
 #include "hittable.h"
 
 #include "core/interval.h"
@@ -76,7 +78,8 @@ public:
         // valid hit 
         rec.t = t;
         rec.p = r.at(t);
-        rec.mat = mat_;
+        rec.mat = mat_.get();
+        rec.mat_id = mat_id_;
 
         // normal
         core::Vec3 outward_norm = Cross(edge1, edge2);
@@ -101,9 +104,14 @@ public:
         gpu_index = i;
     }
 
+    virtual void BindMaterials(material::MaterialTable& table) override {
+        mat_id_ = table.Add(mat_.get());
+    }
+
 private:
     core::Point3 a_, b_, c_, d_;
     std::shared_ptr<Material> mat_;
+    uint32_t mat_id_ = 0;
     Aabb bbox_;
 };
 
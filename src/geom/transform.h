@@ -0,0 +1,108 @@
+#pragma once
+
+#include "core/constants.h"
+#include "core/vec3.h"
+
+#include <cmath>
+
+namespace rt::geom {
+
+/// Affine transform, a 3x3 linear part plus a translation column.
+struct Transform {
+    double m[3][4] = {
+        {1, 0, 0, 0},
+        {0, 1, 0, 0},
+        {0, 0, 1, 0},
+    };
+
+    static Transform Translate(const core::Vec3& t) {
+        Transform r;
+        r.m[0][3] = t.x();
+        r.m[1][3] = t.y();
+        r.m[2][3] = t.z();
+        return r;
+    }
+
+    static Transform Scale(const core::Vec3& s) {
+        Transform r;
+        r.m[0][0] = s.x();
+        r.m[1][1] = s.y();
+        r.m[2][2] = s.z();
+        return r;
+    }
+
+    // rotation about a coordinate axis (0:x 1:y 2:z), in degrees
+    static Transform Rotate(int axis, double degrees) {
+        Transform r;
+        const double c = std::cos(core::DegreesToRadians(degrees));
+        const double s = std::sin(core::DegreesToRadians(degrees));
+        const int a = (axis + 1) % 3;
+        const int b = (axis + 2) % 3;
+        r.m[a][a] = c;  r.m[a][b] = -s;
+        r.m[b][a] = s;  r.m[b][b] = c;
+        return r;
+    }
+
+    // this applied after o
+    Transform operator*(const Transform& o) const {
+        Transform r;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                r.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j] + m[i][2] * o.m[2][j];
+            }
+            r.m[i][3] += m[i][3];
+        }
+        return r;
+    }
+
+    core::Point3 Point(const core::Point3& p) const {
+        return core::Point3(
+            m[0][0] * p.x() + m[0][1] * p.y() + m[0][2] * p.z() + m[0][3],
+            m[1][0] * p.x() + m[1][1] * p.y() + m[1][2] * p.z() + m[1][3],
+            m[2][0] * p.x() + m[2][1] * p.y() + m[2][2] * p.z() + m[2][3]);
+    }
+
+    core::Vec3 Vector(const core::Vec3& v) const {
+        return core::Vec3(
+            m[0][0] * v.x() + m[0][1] * v.y() + m[0][2] * v.z(),
+            m[1][0] * v.x() + m[1][1] * v.y() + m[1][2] * v.z(),
+            m[2][0] * v.x() + m[2][1] * v.y() + m[2][2] * v.z());
+    }
+
+    // multiplies by the transposed linear part; on an inverse transform this
+    // maps object space normals to world space
+    core::Vec3 TransposedVector(const core::Vec3& v) const {
+        return core::Vec3(
+            m[0][0] * v.x() + m[1][0] * v.y() + m[2][0] * v.z(),
+            m[0][1] * v.x() + m[1][1] * v.y() + m[2][1] * v.z(),
+            m[0][2] * v.x() + m[1][2] * v.y() + m[2][2] * v.z());
+    }
+
+    double Determinant() const {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+             - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+             + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    Transform Inverse() const {
+        Transform r;
+        const double inv_det = 1.0 / Determinant();
+        r.m[0][0] =  (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+        r.m[0][1] = -(m[0][1] * m[2][2] - m[0][2] * m[2][1]) * inv_det;
+        r.m[0][2] =  (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        r.m[1][0] = -(m[1][0] * m[2][2] - m[1][2] * m[2][0]) * inv_det;
+        r.m[1][1] =  (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        r.m[1][2] = -(m[0][0] * m[1][2] - m[0][2] * m[1][0]) * inv_det;
+        r.m[2][0] =  (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+        r.m[2][1] = -(m[0][0] * m[2][1] - m[0][1] * m[2][0]) * inv_det;
+        r.m[2][2] =  (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+
+        // translation is -R^-1 t
+        for (int i = 0; i < 3; ++i) {
+            r.m[i][3] = -(r.m[i][0] * m[0][3] + r.m[i][1] * m[1][3] + r.m[i][2] * m[2][3]);
+        }
+        return r;
+    }
+};
+
+} // namespace rt::geom
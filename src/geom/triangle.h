@@ -5,7 +5,10 @@
 #include "core/ray.h"
 #include "core/math_utils.h"
 
+#include "material/material_table.h"
+
 #include "hittable.h"
+#include "primitive_record.h"
 
 #include <memory>
 
@@ -17,6 +20,10 @@ public:
 
     Triangle(const core::Point3& a, const core::Point3& b, const core::Point3& c, std::shared_ptr<material::Material> mat) 
         : a_(a), b_(b), c_(c), mat_(mat) {
+        bbox_ = Bounds(a, b, c);
+    }
+
+    static Aabb Bounds(const core::Point3& a, const core::Point3& b, const core::Point3& c) {
         // per-axis min and max
         core::Point3 min_point(
             std::fmin(a.x(), std::fmin(b.x(), c.x())),
@@ -35,15 +42,26 @@ public:
         min_point += -core::Vec3(eps, eps, eps);
         max_point += core::Vec3(eps, eps, eps);
 
-        bbox_ = Aabb(min_point, max_point);
+        return Aabb(min_point, max_point);
     }
 
     virtual bool Hit(const core::Ray& r, core::Interval ray_t, HitRecord& rec) const override {
         //g_num_primitive_tests++;
+        if (!Intersect(a_, b_, c_, r, ray_t, rec))
+            return false;
+
+        rec.mat = mat_.get();
+        rec.mat_id = mat_id_;
+        return true;
+    }
+
+    // everything but the material, shared with the mapped scene bundle
+    static bool Intersect(const core::Point3& a, const core::Point3& b, const core::Point3& c,
+                          const core::Ray& r, core::Interval ray_t, HitRecord& rec) {
         const float kEpsilon = 1e-6f;  // geometric tolerance
 
-        core::Vec3 edge1 = b_ - a_;
-        core::Vec3 edge2 = c_ - a_;
+        core::Vec3 edge1 = b - a;
+        core::Vec3 edge2 = c - a;
 
         // Möller–Trumbore
         core::Vec3 pvec = core::Cross(r.direction(), edge2);
@@ -54,7 +72,7 @@ public:
             return false;
 
         float inv_det = 1.0f / det;
-        core::Vec3 tvec = r.origin() - a_;
+        core::Vec3 tvec = r.origin() - a;
 
         // barycentric u
         float u = core::Dot(tvec, pvec) * inv_det;
@@ -77,7 +95,6 @@ public:
         // valid hit 
         rec.t = t;
         rec.p = r.at(t);
-        rec.mat = mat_;
 
         // normal
         core::Vec3 outward_norm = core::Cross(edge1, edge2);
@@ -102,9 +119,18 @@ public:
         gpu_index = i;
     }
 
+    virtual void BindMaterials(material::MaterialTable& table) override {
+        mat_id_ = table.Add(mat_.get());
+    }
+
+    virtual void Record(PrimitiveList& list) const override {
+        list.AddTriangle(a_, b_, c_, mat_id_);
+    }
+
 private:
     core::Point3 a_, b_, c_;
     std::shared_ptr<material::Material> mat_;
+    uint32_t mat_id_ = 0;
     Aabb bbox_;
 };
 
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "core/color.h"
+#include "core/constants.h"
+#include "core/interval.h"
+#include "core/math_utils.h"
+#include "core/random.h"
+#include "core/ray.h"
+
+#include "geom/hittable.h"
+
+#include "integrator/ray_state.h"
+
+#include "material/bsdf.h"
+#include "material/material_table.h"
+
+#include "scene/camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The path integrator shared by the renderers. The wavefront renderer runs
+// its vertex functions one bounce at a time over batches of rays, the
+// mega-kernel runs TracePath, the same steps in a loop per path. Both draw
+// vertex d's random numbers from CounterRng(pixel, sample, d + 1), so for
+// the same pixel and sample they trace the same path to the same value.
+
+namespace rt::integrator {
+
+// near bound of every path segment, as in CPURayIntegrator
+constexpr float kRayMin = 0.001f;
+
+// extra cone spread (radians) added by a diffuse bounce
+constexpr float kDiffuseConeSpread = 0.05f;
+
+// ray cone footprint at a hit: world width of the cone there, and the
+// matching uv extent used to pick a texture mip level
+struct Footprint {
+    float  width;
+    double du, dv;
+};
+
+inline Footprint ConeFootprint(const RayState& rs, const geom::HitRecord& rec) {
+    const double len = rs.r.direction().length();
+    const double width = rs.cone_width + rs.cone_spread * rec.t * len;
+
+    // grazing hits stretch the footprint across the surface
+    const double cos_theta = std::fabs(core::Dot(rs.r.direction(), rec.normal)) / len;
+    const double stretched = width / std::max(cos_theta, 0.1);
+
+    return { static_cast<float>(width), stretched * rec.dudp, stretched * rec.dvdp };
+}
+
+// sky gradient returned for rays that leave the scene
+inline core::Color Background(const core::Ray& r) {
+    core::Vec3 unit_direction = core::Normalize(r.direction());
+    auto t = 0.5 * (unit_direction.y() + 1.0);
+    return (1.0 - t) * core::Color(1.0, 1.0, 1.0)
+         + t         * core::Color(0.5, 0.7, 1.0);
+}
+
+// first ray of a path; the camera's dimensions come from bounce 0 of the
+// path's stream
+inline RayState CameraRay(const scene::Camera& cam, int x, int y, int pixel_index, int sample) {
+    core::ScopedRng rng(core::CounterRng(pixel_index, sample, 0, cam.sample_mode_));
+
+    RayState rs;
+    rs.r           = cam.GetRay(x, y);
+    rs.pixel_index = pixel_index;
+    rs.sample      = sample;
+    rs.depth       = 0;
+    rs.throughput  = core::Color(1,1,1);
+    rs.cone_width  = 0.0f;
+    rs.cone_spread = static_cast<float>(cam.get_pixel_spread());
+    return rs;
+}
+
+inline RayState MakeChild(
+    const RayState& rs,
+    const geom::HitRecord& rec,
+    const core::Vec3& wi,
+    float cone_width,
+    float extra_spread
+) {
+    RayState child;
+    child.r           = core::Ray(rec.p, wi);
+    child.pixel_index = rs.pixel_index;
+    child.sample      = rs.sample;
+    child.depth       = rs.depth + 1;
+    child.cone_width  = cone_width;
+    child.cone_spread = rs.cone_spread + extra_spread;
+    return child;
+}
+
+// russian roulette after five bounces, on the stream of the vertex that
+// scattered; false if the path ends, survivors are reweighted
+inline bool RussianRoulette(RayState& child, core::CounterRng& rng) {
+    if (child.depth > 5) {
+        double p = std::max({
+            child.throughput.x(),
+            child.throughput.y(),
+            child.throughput.z()
+        });
+        p = std::clamp(p, 0.1, 0.95);
+
+        if (rng.Uniform() > p)
+            return false;
+        child.throughput /= p;
+    }
+    return true;
+}
+
+// ---------------- Vertices ----------------
+
+// path contribution of a light hit; lights do not scatter
+inline core::Color LightHit(const material::MaterialTable& materials, const RayState& rs, const geom::HitRecord& rec) {
+    const Footprint fp = ConeFootprint(rs, rec);
+    const material::MaterialRecord& m = materials[rec.mat_id];
+    const core::Color emitted = materials.EvalTexture(m.texture, rec.u, rec.v, rec.p, fp.du, fp.dv);
+    return emitted.NearZero() ? core::Color(0,0,0) : rs.throughput * emitted;
+}
+
+// diffuse albedo over the ray cone's footprint
+inline core::Color DiffuseAlbedo(const material::MaterialTable& materials, const geom::HitRecord& rec, const Footprint& fp) {
+    const material::MaterialRecord& m = materials[rec.mat_id];
+    return materials.EvalTexture(m.texture, rec.u, rec.v, rec.p, fp.du, fp.dv);
+}
+
+// cosine-weighted direction around the hit's normal, the scalar form of
+// the wavefront's batched sampling
+inline core::Vec3 DiffuseDirection(const geom::HitRecord& rec, const core::Sample2D& xi) {
+    const core::Vec3 n = core::Normalize(rec.normal);
+    const core::Vec3 local = core::SampleCosineHemisphere(xi.u, xi.v);
+    core::Vec3 t, b;
+    core::BuildOrthonormalBasis(n, t, b);
+    return local.x() * t + local.y() * b + local.z() * n;
+}
+
+// diffuse bounce toward wi, drawn with density pdf; false if the path ends
+inline bool DiffuseChild(
+    const RayState& rs,
+    const geom::HitRecord& rec,
+    const core::Color& albedo,
+    const core::Vec3& wi,
+    float pdf,
+    float cone_width,
+    RayState& child
+) {
+    if (core::Dot(wi, rec.normal) <= 0 || pdf < 1e-6f)
+        return false;
+
+    const core::Color f = material::EvalLambertian(albedo, rec, wi);
+    const float cos_theta = std::max(0.0f, static_cast<float>(core::Dot(wi, rec.normal)));
+
+    child = MakeChild(rs, rec, wi, cone_width, kDiffuseConeSpread);
+    child.throughput = rs.throughput * f * cos_theta / pdf;
+    return true;
+}
+
+// delta lobes: f already encodes the contribution, no cos / pdf. rng is
+// the vertex's stream, advanced past the numbers the lobe drew.
+template <material::MaterialType kType>
+inline bool SpecularChild(
+    const material::MaterialTable& materials,
+    const RayState& rs,
+    const geom::HitRecord& rec,
+    core::CounterRng& rng,
+    RayState& child
+) {
+    const material::MaterialRecord& m = materials[rec.mat_id];
+    const core::Vec3 wo = -core::Normalize(rs.r.direction());
+    core::Vec3 wi;
+    float pdf = 0.0f;
+    core::Color f;
+
+    bool scattered;
+    {
+        // the BSDF kernels draw from the thread's current stream
+        core::ScopedRng scoped(rng);
+        if constexpr (kType == material::MaterialType::kMetal)
+            scattered = material::SampleMetal(m.albedo, m.fuzz, rec, wo, wi, pdf, f);
+        else
+            scattered = material::SampleDielectric(m.ior, rec, wo, wi, pdf, f);
+        rng = core::GetRng();
+    }
+    if (!scattered)
+        return false;
+
+    // specular bounces keep the cone's spread
+    child = MakeChild(rs, rec, wi, ConeFootprint(rs, rec).width, 0.0f);
+    child.throughput = rs.throughput * f;
+    return true;
+}
+
+// ---------------- Whole paths ----------------
+
+// Traces the path of rs to its end and returns its contribution; rays is
+// set to the number of segments intersected. The loop keeps only the
+// current ray, so no stack grows with max_depth. Misses and paths at the
+// depth limit take the background, as in the wavefront's miss bucket.
+inline core::Color TracePath(
+    const geom::Hittable& world,
+    const material::MaterialTable& materials,
+    RayState rs,
+    int max_depth,
+    core::SampleMode mode,
+    int& rays
+) {
+    using material::MaterialType;
+
+    for (rays = 1;; ++rays) {
+        geom::HitRecord rec;
+        const bool hit = world.Hit(rs.r, core::Interval(kRayMin, core::kInfinity), rec);
+        if (!hit || rs.depth >= max_depth)
+            return rs.throughput * Background(rs.r);
+
+        core::CounterRng rng(rs.pixel_index, rs.sample, rs.depth + 1, mode);
+        RayState child;
+        bool scattered = false;
+
+        switch (materials[rec.mat_id].type) {
+            case MaterialType::kDiffuseLight:
+                return LightHit(materials, rs, rec);
+
+            case MaterialType::kLambertian: {
+                const core::Vec3 wi = DiffuseDirection(rec, rng.Next2D());
+                const Footprint fp = ConeFootprint(rs, rec);
+                const core::Color albedo = DiffuseAlbedo(materials, rec, fp);
+                scattered = DiffuseChild(rs, rec, albedo, wi, material::PdfLambertian(rec, wi), fp.width, child) &&
+                            RussianRoulette(child, rng);
+                break;
+            }
+
+            case MaterialType::kMetal:
+                scattered = SpecularChild<MaterialType::kMetal>(materials, rs, rec, rng, child) &&
+                            RussianRoulette(child, rng);
+                break;
+
+            case MaterialType::kDielectric:
+                scattered = SpecularChild<MaterialType::kDielectric>(materials, rs, rec, rng, child) &&
+                            RussianRoulette(child, rng);
+                break;
+        }
+
+        if (!scattered)
+            return core::Color(0,0,0);
+        rs = child;
+    }
+}
+
+} // namespace rt::integrator
@@ -38,6 +38,29 @@ inline void RecordSample(PixelState& ps, const core::Color& sample) {
     ps.sum += sample;
 }
 
+// adds the samples of b to a, as if both had been recorded into one state
+// (Chan et al.'s pairwise update, so partial renders of a pixel can be merged)
+inline void MergePixel(PixelState& a, const PixelState& b) {
+    if( b.samples == 0 ) return;
+    if( a.samples == 0 ) {
+        a = b;
+        return;
+    }
+
+    const double na = a.samples;
+    const double nb = b.samples;
+    const double n = na + nb;
+    for(int c = 0; c < 3; ++c) {
+        double delta = b.mean[c] - a.mean[c];
+        a.mean[c] += delta * nb / n;
+        a.m2[c] += b.m2[c] + delta * delta * na * nb / n;
+    }
+
+    a.sum += b.sum;
+    a.samples += b.samples;
+    a.converged = a.converged && b.converged;
+}
+
 inline core::Color Variance(const PixelState& ps) {
     core::Color var(0,0,0);
     if( ps.samples > 1 ) {
@@ -48,27 +71,48 @@ inline core::Color Variance(const PixelState& ps) {
     return var;
 }
 
-// adaptive sampling convergence test
-// rel_threshold is the relative threshold (0.02 is good)
-// min_spp is minimum samples (16 is good)
-inline bool IsConverged(PixelState& ps, double rel_threshold, int min_spp) {
-    if( ps.samples < min_spp ) return false;
+// relative standard error of the pixel's mean, worst channel
+// (sigma / sqrt(n) / mean, means near black clamped to 1e-3)
+inline double RelativeError(const PixelState& ps) {
+    if( ps.samples < 2 ) return 0.0;
 
     core::Color var = Variance(ps);
-    bool ok = true;
+    double worst = 0.0;
 
-    for(int c= 0; c < 3; ++c) {
+    for(int c = 0; c < 3; ++c) {
         double mu = std::max(std::abs(ps.mean[c]), 1e-3);
         double sigma = std::sqrt(var[c]);
         double err = sigma / std::sqrt(ps.samples);
+        worst = std::max(worst, err / mu);
+    }
 
-        if( err / mu > rel_threshold ) {
-            ok = false;
-            break;
-        }
+    return worst;
+}
+
+// relative standard error of the pixel's luminance, channels taken as
+// independent; like relMSE the denominator is softened (+0.01) so that
+// near-black pixels do not dominate image-wide averages
+inline double LuminanceError(const PixelState& ps) {
+    if( ps.samples < 2 ) return 0.0;
+
+    const double w[3] = { 0.2126, 0.7152, 0.0722 };
+    core::Color var = Variance(ps);
+    double mu = 0.0;
+    double var_mean = 0.0;
+    for(int c = 0; c < 3; ++c) {
+        mu += w[c] * ps.mean[c];
+        var_mean += w[c] * w[c] * var[c] / ps.samples;
     }
 
-    return ok;
+    return std::sqrt(var_mean / (mu * mu + 0.01));
+}
+
+// adaptive sampling convergence test
+// rel_threshold is the relative threshold (0.02 is good)
+// min_spp is minimum samples (16 is good)
+inline bool IsConverged(PixelState& ps, double rel_threshold, int min_spp) {
+    if( ps.samples < min_spp ) return false;
+    return RelativeError(ps) <= rel_threshold;
 }
 
 } // namespace rt::integrator
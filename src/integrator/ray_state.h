@@ -8,8 +8,14 @@ namespace rt::integrator {
 struct RayState {
     core::Ray   r;
     int   pixel_index = 0;
+    int   sample = 0;  // sample pass, keys the path's random stream
     int   depth = 0;
     core::Color throughput = core::Color(1,1,1);
+
+    // ray cone for texture filtering: footprint width at the origin and
+    // growth per unit distance (radians), started from the pixel footprint
+    float cone_width = 0.0f;
+    float cone_spread = 0.0f;
 };
 
 } // namespace rt::integrator
@@ -1,198 +1,520 @@
 #include "core/math_utils.h"
 #include "core/random.h"
-#include "geom/bvh.h"
 #include "scene/camera.h"
-#include "material/material.h"
+#include "scene/camera_path.h"
 #include "scene/scene.h"
-#include "integrator/sampler.h"
-#include "geom/sphere.h"
-#include "geom/rect.h"
+#include "scene/scene_loader.h"
+#include "scene/scene_bundle.h"
 #include "gpu_utils.h"
-#include "material/texture.h"
 #include "core/timer.h"
 #include "renderer/wavefront.h"
+#include "renderer/checkpoint.h"
+#include "renderer/denoiser.h"
+#include "renderer/aov.h"
 #include "renderer/mega_kernel.h"
+#include "renderer/renderer.h"
 #include "integrator/cpu_ray_integrator.h"
-
+#include "scene/image_writer.h"
+#include "scene/texture_cache.h"
+#include "scene/tile_cache.h"
+#include "server/render_server.h"
+#include "server/tile_cluster.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 using namespace rt;
 
-void cornell_box(scene::Scene& world_root) {
-    scene::Scene world;
+namespace {
 
-    // Materials
-    auto red   = std::make_shared<material::Lambertian>(core::Color(.65, .05, .05));
-    auto white = std::make_shared<material::Lambertian>(core::Color(.73, .73, .73));
-    auto green = std::make_shared<material::Lambertian>(core::Color(.12, .45, .15));
-    auto light = std::make_shared<material::DiffuseLight>(core::Color(15, 15, 15));  // Brighter light
-
-    // Standard Cornell Box scaling (10×10×10 world units)
-    const double S = 10.0;       // side length
-    const double eps = 0.01;     // small offset to avoid z-fighting
-
-    // --- Walls ---
-    world.Add(std::make_shared<geom::yz_rect>(0, S, 0, S,  S, green));   // Right wall
-    world.Add(std::make_shared<geom::yz_rect>(0, S, 0, S,  0, red));     // Left wall
-    world.Add(std::make_shared<geom::xz_rect>(0, S, 0, S,  0, white));   // Floor
-    world.Add(std::make_shared<geom::xz_rect>(0, S, 0, S,  S, white));   // Ceiling
-    world.Add(std::make_shared<geom::xy_rect>(0, S, 0, S,  S, white));   // Back wall
-
-    // --- Light in ceiling ---
-    // Standard proportion: light is ~1/3 width of box
-    const double L0 = 3.0;
-    const double L1 = 7.0;
-    world.Add(std::make_shared<geom::xz_rect>(L0, L1, L0, L1, S - eps, light));  
-
-    // --- Objects: Use spheres or blocks ---
-    // geom::Spheres version:
-    auto glass  = std::make_shared<material::Dielectric>(1.5);
-    auto metal_surface = std::make_shared<material::Metal>(core::Color(0.85, 0.85, 0.95), 0.03);
-    auto diffuse = std::make_shared<material::Lambertian>(core::Color(0.8, 0.3, 0.1));
-
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(3.2, 1.0, 7.0), 1.0, diffuse));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(7.0, 1.0, 4.0), 1.0, metal_surface));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(5.0, 1.0, 2.5), 1.0, glass));
-
-    // Add BVH
-    world_root.Add(std::make_shared<geom::Bvh>(world));
+// camera list: one name, "a,b,c" or "all" (sorted)
+std::vector<std::string> CameraNames(const std::string& arg,
+                                     const std::unordered_map<std::string, scene::CameraConfig>& cameras) {
+    std::vector<std::string> names;
+    if( arg == "all" ) {
+        for( const auto& [name, cfg] : cameras ) {
+            names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+    std::stringstream list(arg);
+    std::string name;
+    while( std::getline(list, name, ',') ) {
+        if( !name.empty() ) {
+            names.push_back(name);
+        }
+    }
+    return names;
 }
 
-
-void earth(scene::Scene& world) {
-    auto earth_texture = std::make_shared<material::ImageTexture>("earthmap.jpg");
-    auto earth_surface = std::make_shared<material::Lambertian>(earth_texture);
-    auto globe = std::make_shared<geom::Sphere>(core::Point3(0,0,0), 2, earth_surface);
-
-    world = scene::Scene(globe);
+// output of one view of many: key ("{camera}", "{frame}") is replaced by
+// value, without it the value is added before the extension
+std::string ViewOutput(const std::string& pattern, const std::string& key, const std::string& value) {
+    const size_t at = pattern.find(key);
+    if( at != std::string::npos ) {
+        return pattern.substr(0, at) + value + pattern.substr(at + key.size());
+    }
+    const size_t dot = pattern.find_last_of('.');
+    const size_t slash = pattern.find_last_of('/');
+    if( dot == std::string::npos || (slash != std::string::npos && dot < slash) ) {
+        return pattern + "_" + value;
+    }
+    return pattern.substr(0, dot) + "_" + value + pattern.substr(dot);
 }
 
-void Spheres(scene::Scene& world_root) {
-    scene::Scene world;
+// one image to render: a named camera or a frame of a camera path
+struct View {
+    std::string name;
+    scene::CameraConfig cfg;
+    std::string output;
+};
+
+// a finished image on its way to disk, written while the next view renders
+struct PendingWrite {
+    std::future<double> seconds;  // -1 on failure
+    std::string output;
+};
+
+// waits for the previous view's image, false if it could not be written
+bool FinishWrite(PendingWrite& pending, double& write_seconds) {
+    if( !pending.seconds.valid() ) {
+        return true;
+    }
+    write_seconds = pending.seconds.get();
+    if( write_seconds < 0 ) {
+        std::cerr << "ERROR: Failed to write image '" << pending.output << "'\n";
+        return false;
+    }
+    return true;
+}
 
-    auto earth_texture = std::make_shared<material::ImageTexture>("earthmap.jpg");
-    auto earth_surface = std::make_shared<material::Lambertian>(earth_texture);
-
-    auto material_ground = std::make_shared<material::Lambertian>(core::Color(0.8, 0.8, 0.0));
-    auto material_center = std::make_shared<material::Lambertian>(core::Color(0.1, 0.2, 0.5));
-    auto material_left   = std::make_shared<material::Dielectric>(1.50); // model of air bubble in water
-    auto material_bubble = std::make_shared<material::Dielectric>(1.00 / 1.50);
-    auto material_right  = std::make_shared<material::Metal>(core::Color(0.8, 0.6, 0.2), 1.0);
-
-    world.Add(std::make_shared<geom::Sphere>(core::Point3( 0.0, -100.5, -1.0), 100.0, material_ground));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3( 0.0,    0.0, -1.2),   0.5, material_center));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(-1.0,    0.0, -1.0),   0.5, material_left));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(-1.0,    0.0, -1.0),   0.4, material_bubble));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3( 1.0,    0.0, -1.0),   0.5, material_right));
-
-    auto checker = std::make_shared<material::CheckerTexture>(0.32, core::Color(0.2, 0.3, 0.1), core::Color(.9, .9, .9));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(0,-1000,0), 1000, make_shared<material::Lambertian>(checker)));
-
-    
-    for (int a = -110; a < 110; a++) {
-        for (int b = -110; b < 110; b++) {
-            auto choose_mat = core::RandomDouble();
-            core::Point3 center(a + 0.9*core::RandomDouble(), 0.2, b + 0.9*core::RandomDouble());
-
-            if ((center - core::Point3(4, 0.2, 0)).length() > 0.9) {
-                std::shared_ptr<material::Material> sphere_material;
-
-                if (choose_mat < 0.2) {
-                    world.Add(std::make_shared<geom::Sphere>(center, 0.2, earth_surface));
-                } else if(choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = core::RandomVec3(0, 1);
-                    sphere_material = std::make_shared<material::Lambertian>(albedo);
-                    world.Add(std::make_shared<geom::Sphere>(center, 0.2, sphere_material));
-                } else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = core::RandomVec3(0.5, 1);
-                    auto fuzz = core::RandomDouble(0, 0.5);
-                    sphere_material = std::make_shared<material::Metal>(albedo, fuzz);
-                    world.Add(std::make_shared<geom::Sphere>(center, 0.2, sphere_material));
-                } else {
-                    // glass
-                    sphere_material = std::make_shared<material::Dielectric>(1.5);
-                    world.Add(std::make_shared<geom::Sphere>(center, 0.2, sphere_material));
+// how a single view is rendered, from the command line
+struct RenderOptions {
+    std::string scene_path;          // identifies checkpoints together with the camera
+    std::string checkpoint;          // periodic checkpoint file, empty for none
+    double checkpoint_seconds = 60.0;
+    std::string resume;              // checkpoint to continue from
+    std::string preview;             // progressive preview image, empty for none
+    double preview_seconds = 0.0;    // 0: after every sample pass
+    double time_budget = 0.0;        // seconds, 0 for none
+    double noise_target = 0.0;       // mean relative error to stop at, 0 for none
+    int max_spp = 0;                 // samples per pixel cap of the budgets, 0: 16x the camera's
+    renderer::Schedule schedule = renderer::Schedule::kUniform;
+    bool denoise = false;            // a-trous filter guided by first-hit buffers
+    bool guide = false;              // path guiding of diffuse bounces
+    int cache_bounces = 0;           // radiance cache ends diffuse paths this deep, 0 for off
+    renderer::Strategy strategy = renderer::Strategy::kAuto;  // wavefront passes or whole paths per pixel
+    std::vector<renderer::Aov> aovs; // written next to the image, see renderer/aov.h
+};
+
+// the first Ctrl-C finishes the current sample pass and writes the image,
+// a second one kills the process
+std::atomic<bool> g_stop_requested{false};
+
+void RequestStop(int) {
+    g_stop_requested = true;
+    std::signal(SIGINT, SIG_DFL);
+}
+// starts writing an image and its AOVs on another thread
+void StartWrite(PendingWrite& write, const std::string& output, std::vector<core::Color> image,
+                std::vector<std::pair<std::string, std::vector<core::Color>>> aov_images, int w, int h) {
+    write.output = output;
+    write.seconds = std::async(std::launch::async,
+        [image = std::move(image), aov_images = std::move(aov_images), w, h, out = output]() {
+            core::Timer write_clock;
+            if( !scene::WriteImage(out, image, w, h) ) {
+                return -1.0;
+            }
+            for( const auto& [path, aov_image] : aov_images ) {
+                if( !scene::WriteImage(path, aov_image, w, h) ) {
+                    return -1.0;
                 }
             }
-        }
-    }
-
-    auto material1 = std::make_shared<material::Dielectric>(1.5);
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(0, 1, 0), 1.0, material1));
-
-    auto material2 = std::make_shared<material::Lambertian>(core::Color(0.4, 0.2, 0.1));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(-4, 0, 0), 1.0, material2));
-
-    auto material3 = std::make_shared<material::Metal>(core::Color(0.7, 0.6, 0.5), 0.0);
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(4, 1, 0), 1.0, material3));
+            return write_clock.elapsed();
+        });
+}
 
-    //world.Add(std::make_shared<triangle>(point3(-2, -2, 0), point3(2, -2, 0), point3(0, 2, 0), material2));
-    
-    // auto red = std::std::make_shared<lambertian>(color(0.8,0.1,0.1));
+// auto mode's choice by image width and height, measured once for the
+// scene and reused by every view of that size
+using CalibratedRenderers = std::map<std::pair<int, int>, renderer::Strategy>;
 
-    // auto bunny = load_obj(std::string(PROJECT_SOURCE_DIR) + "/models/stanford-bunny.obj", red, 50);
+// renders one view of the loaded scene and starts writing it in the
+// background; the scene, its Bvh and the OpenMP thread team are shared by
+// every view
+double RenderView(const scene::Scene& world, integrator::CPURayIntegrator& integrator,
+                  const View& view, const RenderOptions& options, CalibratedRenderers& calibrated,
+                  PendingWrite& write) {
+    scene::ColorCamera cam;
+    cam.SetFromConfig(view.cfg);
+    cam.Initialize();
 
-    // bvh wrapper
-    // auto bunny_bvh = std::std::make_shared<bvh_node>(bunny->tris.objects, 0, bunny->tris.objects.size());
+    renderer::WavefrontRenderer wavefront(world, cam, integrator, cam.max_depth_, cam.samples_per_pixel_, 2 * 8192);
+    if( !options.checkpoint.empty() ) {
+        wavefront.SetCheckpoint(options.checkpoint, options.checkpoint_seconds);
+    }
+    wavefront.SetCheckpointKey(renderer::CheckpointKey(options.scene_path, view.cfg));
+    if( !options.preview.empty() ) {
+        wavefront.SetPreview(options.preview, options.preview_seconds);
+    }
+    wavefront.SetTimeBudget(options.time_budget);
+    wavefront.SetNoiseTarget(options.noise_target);
+    wavefront.SetBudgetSampleCap(options.max_spp);
+    wavefront.SetSchedule(options.schedule);
+    wavefront.SetGuiding(options.guide);
+    wavefront.SetRadianceCache(options.cache_bounces);
+    wavefront.SetCollectGuides(options.denoise || renderer::NeedsGuides(options.aovs));
+    if( !options.resume.empty() && !wavefront.Resume(options.resume) ) {
+        return -1.0;
+    }
 
-    // world.Add(bunny_bvh);
+    renderer::MegaKernel mega_kernel(world, cam, cam.max_depth_, cam.samples_per_pixel_);
 
-    world_root.Add(std::make_shared<geom::Bvh>(world));
-}
+    // the mega-kernel only renders a fixed number of samples
+    const bool needs_wavefront = !options.checkpoint.empty() || !options.preview.empty() || !options.resume.empty() ||
+        options.time_budget > 0 || options.noise_target > 0 || options.schedule != renderer::Schedule::kUniform ||
+        options.guide || options.cache_bounces > 0 || options.denoise || !options.aovs.empty();
 
-void checkered_spheres(scene::Scene& world_root) {
-    scene::Scene world;
+    core::Timer render_clock;
+    renderer::Strategy strategy = options.strategy;
+    if( needs_wavefront && strategy == renderer::Strategy::kMegaKernel ) {
+        std::cerr << "WARNING: The options given need the wavefront renderer, using it\n";
+    }
+    if( needs_wavefront ) {
+        strategy = renderer::Strategy::kWavefront;
+    } else if( strategy == renderer::Strategy::kAuto ) {
+        const std::pair<int, int> size(cam.get_image_width(), cam.get_image_height());
+        auto known = calibrated.find(size);
+        if( known == calibrated.end() ) {
+            const size_t fastest = renderer::Calibrate({ &wavefront, &mega_kernel }, size.first, size.second);
+            known = calibrated.emplace(size, fastest == 0 ? renderer::Strategy::kWavefront
+                                                          : renderer::Strategy::kMegaKernel).first;
+        }
+        strategy = known->second;
+    }
 
-    auto checker = std::make_shared<material::CheckerTexture>(0.32, core::Color(.2, .3, .1), core::Color(.9, .9, .9));
+    renderer::Renderer& renderer = strategy == renderer::Strategy::kMegaKernel
+        ? static_cast<renderer::Renderer&>(mega_kernel) : wavefront;
+    renderer.SetStopFlag(&g_stop_requested);
+    renderer.Render();
+    const double render_seconds = render_clock.elapsed();
+
+    std::vector<core::Color> image;
+    if( options.denoise ) {
+        core::Timer denoise_clock;
+        renderer::Denoise(wavefront.Pixels(), wavefront.Guides(), cam.get_image_width(), cam.get_image_height(), image);
+        std::clog << "Denoise: " << std::setprecision(3) << denoise_clock.elapsed() << "s\n";
+    } else {
+        image = renderer.Framebuffer();
+    }
 
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(0,-10, 0), 10, make_shared<material::Lambertian>(checker)));
-    world.Add(std::make_shared<geom::Sphere>(core::Point3(0, 10, 0), 10, make_shared<material::Lambertian>(checker)));
+    // every AOV of the same pass, written along with the image
+    std::vector<std::pair<std::string, std::vector<core::Color>>> aov_images;
+    if( !options.aovs.empty() && (view.output.empty() || view.output == "-") ) {
+        std::cerr << "WARNING: AOVs need an output file, skipped\n";
+    } else {
+        for( renderer::Aov aov : options.aovs ) {
+            aov_images.emplace_back(renderer::AovPath(view.output, aov), std::vector<core::Color>());
+            renderer::AovImage(aov, wavefront.Pixels(), wavefront.Guides(), cam.get_image_width(), cam.get_image_height(),
+                               aov_images.back().second);
+        }
+    }
 
-    world_root.Add(std::make_shared<geom::Bvh>(world));
+    StartWrite(write, view.output, std::move(image), std::move(aov_images), cam.get_image_width(), cam.get_image_height());
+    return render_seconds;
 }
 
+}  // namespace
+
 int main(int argc, char** argv) {
     core::Timer clock;
     clock.reset();
 
-    auto cameras = scene::loadCameras("cameras.json");
+    // positional: camera name(s), output path; options start with --
+    std::vector<std::string> positional;
+    std::string scene_path = "scenes/cornell.json";
+    std::string bundle_out;
+    std::string sequence_path;
+    std::string serve_socket;
+    std::string submit_socket;
+    std::string worker_address;
+    int coordinate_port = 0;
+    int tile_size = 64;
+    int sample_splits = 1;
+    RenderOptions render_options;
+    size_t texture_cache_mb = 0;
+    for( int i = 1; i < argc; ++i ) {
+        std::string arg = argv[i];
+        if( arg == "--scene" && i + 1 < argc ) {
+            scene_path = argv[++i];
+        } else if( arg == "--sequence" && i + 1 < argc ) {
+            sequence_path = argv[++i];
+        } else if( arg == "--serve" && i + 1 < argc ) {
+            serve_socket = argv[++i];
+        } else if( arg == "--submit" && i + 1 < argc ) {
+            submit_socket = argv[++i];
+        } else if( arg == "--coordinate" && i + 1 < argc ) {
+            coordinate_port = std::atoi(argv[++i]);
+        } else if( arg == "--worker" && i + 1 < argc ) {
+            worker_address = argv[++i];
+        } else if( arg == "--tile" && i + 1 < argc ) {
+            tile_size = std::atoi(argv[++i]);
+        } else if( arg == "--sample-splits" && i + 1 < argc ) {
+            sample_splits = std::atoi(argv[++i]);
+        } else if( arg == "--checkpoint" && i + 1 < argc ) {
+            render_options.checkpoint = argv[++i];
+        } else if( arg == "--checkpoint-every" && i + 1 < argc ) {
+            render_options.checkpoint_seconds = std::atof(argv[++i]);
+        } else if( arg == "--resume" && i + 1 < argc ) {
+            render_options.resume = argv[++i];
+        } else if( arg == "--preview" && i + 1 < argc ) {
+            render_options.preview = argv[++i];
+        } else if( arg == "--preview-every" && i + 1 < argc ) {
+            render_options.preview_seconds = std::atof(argv[++i]);
+        } else if( arg == "--time-budget" && i + 1 < argc ) {
+            render_options.time_budget = std::atof(argv[++i]);
+        } else if( arg == "--noise-target" && i + 1 < argc ) {
+            render_options.noise_target = std::atof(argv[++i]);
+        } else if( arg == "--max-spp" && i + 1 < argc ) {
+            render_options.max_spp = std::max(std::atoi(argv[++i]), 0);
+        } else if( arg == "--schedule" && i + 1 < argc ) {
+            if( !renderer::ParseSchedule(argv[++i], render_options.schedule) ) {
+                return 1;
+            }
+        } else if( arg == "--denoise" ) {
+            render_options.denoise = true;
+        } else if( arg == "--guide" ) {
+            render_options.guide = true;
+        } else if( arg == "--renderer" && i + 1 < argc ) {
+            if( !renderer::ParseStrategy(argv[++i], render_options.strategy) ) {
+                return 1;
+            }
+        } else if( arg == "--radiance-cache" && i + 1 < argc ) {
+            render_options.cache_bounces = std::max(std::atoi(argv[++i]), 0);
+        } else if( arg == "--aov" && i + 1 < argc ) {
+            if( !renderer::ParseAovs(argv[++i], render_options.aovs) ) {
+                return 1;
+            }
+        } else if( arg == "--bundle-out" && i + 1 < argc ) {
+            bundle_out = argv[++i];
+        } else if( arg == "--texture-cache" && i + 1 < argc ) {
+            texture_cache_mb = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    // out-of-core textures, tiles are paged through a fixed budget cache
+    if( texture_cache_mb > 0 ) {
+        scene::TextureCache::Global().EnableStreaming(texture_cache_mb << 20);
+    }
+
+    // render daemon: jobs come in over a Unix socket, scenes stay loaded
+    if( !serve_socket.empty() ) {
+        server::ServerOptions options;
+        options.socket_path = serve_socket;
+        return server::RunRenderServer(options) ? 0 : 1;
+    }
+
+    // client of a running daemon, the request is the first argument or stdin
+    if( !submit_socket.empty() ) {
+        std::string request;
+        if( !positional.empty() ) {
+            request = positional[0];
+        } else {
+            std::getline(std::cin, request, '\0');
+        }
+        return server::SubmitRequest(submit_socket, request, std::cout);
+    }
 
+    // render node of a cluster, scene and camera come from the coordinator
+    if( !worker_address.empty() ) {
+        return server::RunWorker(worker_address) ? 0 : 1;
+    }
+
+    std::unordered_map<std::string, scene::CameraConfig> cameras;
+    try {
+        cameras = scene::loadCameras("cameras.json");
+    } catch( const std::exception& e ) {
+        std::cerr << "ERROR: Could not read 'cameras.json': " << e.what() << "\n";
+        return 1;
+    }
+
+    // one camera, a comma separated list or "all"; several cameras render
+    // in one process and share the scene
     std::string active = "default";
-    if( argc > 1 ) {
-        active = argv[1];
+    if( positional.size() > 0 ) {
+        active = positional[0];
+    }
+
+    // output format is chosen by extension, stdout gets binary ppm
+    std::string output = "-";
+    if( positional.size() > 1 ) {
+        output = positional[1];
+    }
+    // a bad extension is reported before rendering, not after
+    scene::ImageFormat format;
+    if( (output != "-" && !scene::FormatFromPath(output, format)) ||
+        (!render_options.preview.empty() && !scene::FormatFromPath(render_options.preview, format)) ) {
+        return 1;
     }
 
-    if( !cameras.count(active) ) {
+    std::vector<std::string> names = CameraNames(active, cameras);
+    const bool batch = names.size() > 1 || !sequence_path.empty();
+    if( names.size() > 1 ) {
+        for( const auto& name : names ) {
+            if( !cameras.count(name) ) {
+                std::cerr << "ERROR: Camera '" << name << "' not found\n";
+                return 1;
+            }
+        }
+    } else if( names.empty() || !cameras.count(names[0]) ) {
         std::cerr << "Camera '" << active << "' not found. Using default.\n";
-        active = "default";
+        names = { "default" };
+    }
+    if( batch && output == "-" ) {
+        std::cerr << "ERROR: Rendering several images needs an output path\n";
+        return 1;
+    }
+    if( batch && (!render_options.checkpoint.empty() || !render_options.resume.empty()) ) {
+        std::cerr << "ERROR: Checkpoints are for a single view\n";
+        return 1;
+    }
+    // a resumed render keeps checkpointing to the file it came from
+    if( !render_options.resume.empty() && render_options.checkpoint.empty() ) {
+        render_options.checkpoint = render_options.resume;
+    }
+    render_options.scene_path = scene_path;
+
+    // hand the frame out to workers instead of rendering it here
+    if( coordinate_port > 0 ) {
+        server::CoordinatorOptions options;
+        options.port = coordinate_port;
+        options.scene_path = scene_path;
+        options.camera = cameras[names[0]];
+        options.output = output;
+        options.tile_size = tile_size;
+        options.sample_splits = sample_splits;
+        return server::RunCoordinator(options) ? 0 : 1;
     }
-    scene::ColorCamera cam;
-    cam.SetFromConfig(cameras[active]);
-    cam.Initialize();
 
-    scene::Scene world;
-    switch(4) {
-        case 1: Spheres(world); break;
-        case 2: checkered_spheres(world); break;
-        case 3: earth(world); break;
-        case 4: cornell_box(world); break;
+    // a sequence animates the (first) camera along a keyframed path
+    std::vector<View> views;
+    if( !sequence_path.empty() ) {
+        scene::CameraPath path;
+        if( !path.Load(sequence_path) ) {
+            return 1;
+        }
+        for( int f = 0; f < path.Frames(); ++f ) {
+            std::ostringstream frame;
+            frame << std::setw(4) << std::setfill('0') << f;
+            views.push_back({ "frame " + frame.str(), path.At(f, cameras[names[0]]),
+                              ViewOutput(output, "{frame}", frame.str()) });
+        }
+    } else {
+        for( const auto& name : names ) {
+            views.push_back({ name, cameras[name], batch ? ViewOutput(output, "{camera}", name) : output });
+        }
     }
 
-    integrator::DefaultSampler default_sampler(cam.samples_per_pixel_);
-    integrator::AdaptiveSampler adaptive_sampler(30, 250, 0.1f);
+    scene::Scene world;
+    scene::SceneStats stats;
+    if( !scene::LoadScene(scene_path, world, &stats) ) {
+        return 1;
+    }
+    std::clog << "Scene: " << scene_path << ", " << stats.primitives << " primitives, "
+        << stats.triangles << " mesh triangles, " << stats.instances << " instances, "
+        << stats.materials << " materials\n";
+    std::clog << "Scene load: " << std::setprecision(3) << stats.TotalSeconds() << "s (parse "
+        << stats.parse_seconds << "s, build " << stats.build_seconds << "s, bvh "
+        << stats.bvh_seconds << "s, materials " << stats.table_seconds << "s)\n";
+
+    // convert only: the loaded scene is written as a mapped bundle
+    if( !bundle_out.empty() ) {
+        core::Timer bundle_clock;
+        if( !scene::WriteSceneBundle(bundle_out, world) ) {
+            return 1;
+        }
+        std::clog << "Bundle: " << bundle_out << " written in " << std::setprecision(3)
+            << bundle_clock.elapsed() << "s\n";
+        return 0;
+    }
 
-    //renderer::MegaKernel renderer(world, cam, default_sampler);
+    auto& textures = scene::TextureCache::Global();
+    if( textures.Count() > 0 ) {
+        std::clog << "Textures: " << textures.Count() << " images, "
+            << std::setprecision(3) << textures.MemoryBytes() / (1024.0 * 1024.0) << " MiB\n";
+    }
 
     integrator::CPURayIntegrator integrator(&world); 
+    std::signal(SIGINT, RequestStop);
+
+    // view N is written while view N + 1 sets up and renders
+    const double setup_seconds = clock.elapsed();
+    core::Timer loop_clock;
+    double total_render = 0.0;
+    double total_write = 0.0;
+    double write_seconds = 0.0;
+    PendingWrite pending;
+    CalibratedRenderers calibrated;
+    for( const auto& view : views ) {
+        core::Timer view_clock;
+        PendingWrite next;
+        const double render_seconds = RenderView(world, integrator, view, render_options, calibrated, next);
+        if( render_seconds < 0 ) {
+            return 1;
+        }
+        if( !FinishWrite(pending, write_seconds) ) {
+            return 1;
+        }
+        pending = std::move(next);
+        total_render += render_seconds;
+        total_write += write_seconds;
 
-    renderer::WavefrontRenderer renderer(world, cam, integrator, cam.max_depth_, cam.samples_per_pixel_, 2 * 8192);
+        if( batch ) {
+            std::clog << "View " << view.name << " -> " << view.output << ": render "
+                << std::setprecision(3) << render_seconds << "s, total " << view_clock.elapsed() << "s\n";
+        }
+        if( g_stop_requested ) {
+            break;
+        }
+    }
+    if( !FinishWrite(pending, write_seconds) ) {
+        return 1;
+    }
+    total_write += write_seconds;
+    const double loop_seconds = loop_clock.elapsed();
 
-    renderer.Render();
+    if( !batch ) {
+        std::clog << "Image write: " << std::setprecision(2) << write_seconds << "s\n";
+    }
+
+    if( textures.Streaming() ) {
+        auto& tiles = scene::TileCache::Global();
+        std::clog << "Texture tiles: " << tiles.Hits() << " hits, " << tiles.Misses() << " misses, peak "
+            << std::setprecision(3) << tiles.PeakBytes() / (1024.0 * 1024.0) << " MiB\n";
+    }
+
+    // setup is paid once, so the per view cost approaches the render time
+    if( batch ) {
+        const double n = double(views.size());
+        std::clog << (sequence_path.empty() ? "Batch: " : "Sequence: ") << views.size()
+            << " images, setup " << std::setprecision(3) << setup_seconds
+            << "s once; per image: render " << total_render / n << "s, write " << total_write / n
+            << "s (overlapped), overall " << loop_seconds / n << "s; "
+            << long(n * 3600.0 / loop_seconds) << " frames/hour\n";
+    }
 
     std::clog << "Runtime: " << std::setprecision(2) << clock.elapsed() << "s" << std::flush;
 }
-
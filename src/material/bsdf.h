@@ -0,0 +1,149 @@
+#pragma once
+
+#include "core/color.h"
+#include "core/constants.h"
+#include "core/math_utils.h"
+#include "core/random.h"
+#include "core/vec3.h"
+
+#include "geom/hittable.h"
+
+#include <algorithm>
+#include <cmath>
+
+// BSDF kernels shared by the Material classes and the id-based MaterialTable.
+// Parameters come in as plain values, so callers decide where albedo etc.
+// come from (virtual texture lookup or table lookup).
+//
+// Conventions: wo points toward the viewer, wi is the sampled direction.
+// Specular lobes return pdf = 1 and fold cos/pdf into f.
+
+namespace rt::material {
+
+// ---------------- Lambertian ----------------
+
+inline core::Color EvalLambertian(const core::Color& albedo, const geom::HitRecord& rec, const core::Vec3& wi) {
+    if (core::Dot(rec.normal, wi) <= 0)
+        return core::Color(0,0,0);
+    return albedo / core::kPi;
+}
+
+inline float PdfLambertian(const geom::HitRecord& rec, const core::Vec3& wi) {
+    float cosTheta = core::Dot(rec.normal, wi);
+    return (cosTheta <= 0.0f) ? 0.0f : cosTheta / core::kPi;
+}
+
+inline bool SampleLambertian(
+    const core::Color& albedo,
+    const geom::HitRecord& rec,
+    core::Vec3& wi,
+    float& pdf,
+    core::Color& f
+) {
+    // Generate cosine-weighted direction in hemisphere
+    wi = core::RandomCosineDirection(rec.normal);
+
+    // Check if it's above the surface
+    if (core::Dot(wi, rec.normal) <= 0)
+        return false;
+
+    pdf = PdfLambertian(rec, wi);
+    f = EvalLambertian(albedo, rec, wi);
+    return true;
+}
+
+// ---------------- Metal ----------------
+
+inline bool SampleMetal(
+    const core::Color& albedo,
+    double fuzz,
+    const geom::HitRecord& rec,
+    const core::Vec3& wo,
+    core::Vec3& wi,
+    float& pdf,
+    core::Color& f
+) {
+    // Reflect wo (which points toward camera) to get wi
+    wi = core::Reflect(-wo, rec.normal);
+    wi += fuzz * core::RandomUnitVector();
+    wi = core::Normalize(wi);
+
+    if (core::Dot(wi, rec.normal) <= 0)
+        return false;
+
+    // For delta distributions, we encode the BSDF/pdf in f
+    // The rendering equation's cos(theta)/pdf cancels out
+    pdf = 1.0f;
+    f = albedo;
+    return true;
+}
+
+// ---------------- Dielectric ----------------
+
+// Schlick's approximation
+inline double SchlickReflectance(double cosine, double ref_idx) {
+    double r0 = (1.0 - ref_idx) / (1.0 + ref_idx);
+    r0 = r0 * r0;
+    return r0 + (1.0 - r0) * std::pow(1.0 - cosine, 5.0);
+}
+
+inline bool SampleDielectric(
+    double ref_idx,
+    const geom::HitRecord& rec,
+    const core::Vec3& wo,
+    core::Vec3& wi,
+    float& pdf,
+    core::Color& f
+) {
+    core::Vec3 n = rec.normal;
+    bool entering = rec.front_face;
+
+    double eta_i = 1.0;
+    double eta_t = ref_idx;
+
+    if (!entering)
+        std::swap(eta_i, eta_t);
+
+    double eta = eta_i / eta_t;
+
+    // incident direction IN BSDF space is -wo
+    core::Vec3 wi_incident = -core::Normalize(wo);
+
+    double cos_theta_i = core::Dot(wi_incident, n);
+    cos_theta_i = std::clamp(cos_theta_i, -1.0, 1.0);
+
+    double sin_theta_i = std::sqrt(std::max(0.0, 1.0 - cos_theta_i * cos_theta_i));
+    double sin_theta_t = eta * sin_theta_i;
+
+    bool total_internal_reflection = sin_theta_t >= 1.0;
+
+    pdf = 1.0f;  // delta distribution → pdf = 1
+
+    if (total_internal_reflection) {
+        // perfect reflection
+        wi = core::Reflect(wi_incident, n);
+        f = core::Color(1.0, 1.0, 1.0);  // scale not needed; handled by MIS
+        return true;
+    }
+
+    // Fresnel reflectance
+    double Fr = SchlickReflectance(std::abs(cos_theta_i), ref_idx);
+
+    if (core::RandomDouble() < Fr) {
+        // reflection branch
+        wi = core::Reflect(wi_incident, n);
+        f = core::Color(1.0, 1.0, 1.0);
+        return true;
+    }
+
+    // refraction branch
+    wi = core::Refract(wi_incident, n, eta);
+
+    // transmission BSDF includes Jacobian
+    double factor = (eta * eta);
+    f = core::Color(factor, factor, factor);
+
+    return true;
+}
+
+} // namespace rt::material
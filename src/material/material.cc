@@ -1,4 +1,5 @@
 #include "material.h"
+#include "bsdf.h"
 #include "geom/hittable.h"
 #include "core/random.h"
 #include "core/constants.h"
@@ -50,27 +51,17 @@ float Lambertian::Pdf(
     const core::Vec3& wi,
     const core::Vec3& /*wo*/
 ) const {
-    float cosTheta = core::Dot(rec.normal, wi);
-    return (cosTheta <= 0.0f) ? 0.0f : cosTheta / core::kPi;
+    return PdfLambertian(rec, wi);
 }
 
 bool Lambertian::Sample(
     const geom::HitRecord& rec,
-    const core::Vec3& wo,
+    const core::Vec3& /*wo*/,
     core::Vec3& wi,
     float& pdf,
     core::Color& f
 ) const {
-    // Generate cosine-weighted direction in hemisphere
-    wi = core::RandomCosineDirection(rec.normal);
-    
-    // Check if it's above the surface
-    if (core::Dot(wi, rec.normal) <= 0)
-        return false;
-    
-    pdf = Pdf(rec, wi, wo);
-    f = Eval(rec, wi, wo);
-    return true;
+    return SampleLambertian(tex_->Value(rec.u, rec.v, rec.p), rec, wi, pdf, f);
 }
 
 // ---------------- Metal ----------------
@@ -121,23 +112,7 @@ bool Metal::Sample(
     float& pdf,
     core::Color& f
 ) const {
-    // Reflect wo (which points toward camera) to get wi
-    wi = core::Reflect(-wo, rec.normal);
-    wi += fuzz_ * core::RandomUnitVector();
-    wi = core::Normalize(wi); 
-
-    if (core::Dot(wi, rec.normal) <= 0)
-        return false;
-
-    // For delta distributions, we encode the BSDF/pdf in f
-    // The rendering equation's cos(theta)/pdf cancels out
-    pdf = 1.0f;
-    
-    // For specular materials: f = albedo * cos(theta) / pdf
-    // Since pdf = 1 and we want cos to cancel in renderer, we include it here
-    f = albedo_;
-    
-    return true;
+    return SampleMetal(albedo_, fuzz_, rec, wo, wi, pdf, f);
 }
 
 // ---------------- Dielectric ----------------
@@ -197,68 +172,12 @@ bool Dielectric::Sample(
     core::Vec3& wi,
     float& pdf,
     core::Color& f
-) const 
-{
-    // BSDF conventions:
-    // wo = outgoing direction (toward camera)
-    // wi = incoming direction (sampled)
-    
-    core::Vec3 n = rec.normal;
-    bool entering = rec.front_face;
-
-    double eta_i = 1.0;
-    double eta_t = ref_idx_;
-
-    if (!entering)
-        std::swap(eta_i, eta_t);
-
-    double eta = eta_i / eta_t;
-
-    // incident direction IN BSDF space is -wo
-    core::Vec3 wi_incident = -core::Normalize(wo);
-
-    double cos_theta_i = core::Dot(wi_incident, n);
-    cos_theta_i = std::clamp(cos_theta_i, -1.0, 1.0);
-
-    double sin_theta_i = std::sqrt(std::max(0.0, 1.0 - cos_theta_i * cos_theta_i));
-    double sin_theta_t = eta * sin_theta_i;
-
-    bool total_internal_reflection = sin_theta_t >= 1.0;
-
-    pdf = 1.0f;  // delta distribution → pdf = 1
-
-    if (total_internal_reflection) {
-        // perfect reflection
-        wi = core::Reflect(wi_incident, n);
-        f = core::Color(1.0, 1.0, 1.0);  // scale not needed; handled by MIS
-        return true;
-    }
-
-    // Fresnel reflectance
-    double cos_theta_t = std::sqrt(std::max(0.0, 1.0 - sin_theta_t * sin_theta_t));
-    double Fr = Reflectance(std::abs(cos_theta_i), ref_idx_);  
-
-    if (core::RandomDouble() < Fr) {
-        // reflection branch
-        wi = core::Reflect(wi_incident, n);
-        f = core::Color(1.0, 1.0, 1.0);
-        return true;
-    }
-
-    // refraction branch
-    wi = core::Refract(wi_incident, n, eta);
-
-    // transmission BSDF includes Jacobian
-    double factor = (eta * eta);
-    f = core::Color(factor, factor, factor);
-
-    return true;
+) const {
+    return SampleDielectric(ref_idx_, rec, wo, wi, pdf, f);
 }
 
 double Dielectric::Reflectance(double cosine, double ref_idx) {
-    double r0 = (1.0 - ref_idx) / (1.0 + ref_idx);
-    r0 = r0 * r0;
-    return r0 + (1.0 - r0) * std::pow(1.0 - cosine, 5.0);
+    return SchlickReflectance(cosine, ref_idx);
 }
 
 
@@ -4,6 +4,7 @@
 #include "core/color.h"
 #include "core/ray.h"
 #include "core/vec3.h"
+#include "material_record.h"
 #include "texture.h"
 
 namespace rt::geom { class HitRecord; }
@@ -52,6 +53,9 @@ public:
     ) const {
         return core::Color(0,0,0);
     }
+
+    // plain-data form for the MaterialTable, registers referenced textures
+    virtual MaterialRecord Record(MaterialTable& table) const = 0;
 };
 
 
@@ -87,6 +91,8 @@ public:
         core::Color& f
     ) const override;
 
+    MaterialRecord Record(MaterialTable& table) const override;
+
 private:
     std::shared_ptr<Texture> tex_;
 };
@@ -125,6 +131,8 @@ public:
         core::Color& f
     ) const override;
 
+    MaterialRecord Record(MaterialTable& table) const override;
+
 private:
     core::Color albedo_;
     double fuzz_;
@@ -164,6 +172,8 @@ public:
         core::Color& f
     ) const override;
 
+    MaterialRecord Record(MaterialTable& table) const override;
+
 private:
     double ref_idx_;
 
@@ -209,6 +219,8 @@ public:
         double u, double v, const core::Point3& p
     ) const override;
 
+    MaterialRecord Record(MaterialTable& table) const override;
+
 private:
     std::shared_ptr<Texture> emit_;
 };
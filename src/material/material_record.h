@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core/color.h"
+
+#include <cstdint>
+
+namespace rt::scene { class Image; }
+
+namespace rt::material {
+
+class MaterialTable;
+
+// Plain-data descriptions of materials and textures, stored contiguously in
+// a MaterialTable and referenced by 32 bit id. The Material / Texture classes
+// convert themselves into these through Record().
+
+constexpr uint32_t kInvalidId = UINT32_MAX;
+
+enum class TextureType : uint32_t {
+    kSolid,
+    kChecker,
+    kImage,
+};
+
+struct TextureRecord {
+    TextureType type = TextureType::kSolid;
+
+    core::Color color = core::Color(0,0,0);  // solid
+
+    double   inv_scale = 1.0;                // checker
+    uint32_t even = kInvalidId;
+    uint32_t odd  = kInvalidId;
+
+    const scene::Image* image = nullptr;     // image, owned by the TextureCache
+};
+
+enum class MaterialType : uint32_t {
+    kLambertian,
+    kMetal,
+    kDielectric,
+    kDiffuseLight,
+};
+
+struct MaterialRecord {
+    MaterialType type = MaterialType::kLambertian;
+
+    uint32_t    texture = kInvalidId;        // lambertian albedo / light emission
+    core::Color albedo  = core::Color(0,0,0);  // metal
+    double      fuzz    = 0.0;               // metal
+    double      ior     = 1.0;               // dielectric
+};
+
+} // namespace rt::material
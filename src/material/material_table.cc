@@ -0,0 +1,188 @@
+#include "material_table.h"
+
+#include "bsdf.h"
+#include "material.h"
+#include "texture.h"
+
+#include "geom/hittable.h"
+
+#include <cmath>
+
+namespace rt::material {
+
+// ---------------- Table building ----------------
+
+uint32_t MaterialTable::Add(const Material* mat) {
+    if (!mat) return kInvalidId;
+
+    auto it = material_ids_.find(mat);
+    if (it != material_ids_.end())
+        return it->second;
+
+    MaterialRecord record = mat->Record(*this);
+    uint32_t id = static_cast<uint32_t>(materials_.size());
+    materials_.push_back(record);
+    material_ids_.emplace(mat, id);
+    return id;
+}
+
+uint32_t MaterialTable::AddTexture(const Texture* tex) {
+    if (!tex) return kInvalidId;
+
+    auto it = texture_ids_.find(tex);
+    if (it != texture_ids_.end())
+        return it->second;
+
+    // children (checker) are registered inside Record()
+    TextureRecord record = tex->Record(*this);
+    uint32_t id = static_cast<uint32_t>(textures_.size());
+    textures_.push_back(record);
+    texture_ids_.emplace(tex, id);
+    return id;
+}
+
+uint32_t MaterialTable::AddRecord(const MaterialRecord& record) {
+    materials_.push_back(record);
+    return static_cast<uint32_t>(materials_.size() - 1);
+}
+
+uint32_t MaterialTable::AddTextureRecord(const TextureRecord& record) {
+    textures_.push_back(record);
+    return static_cast<uint32_t>(textures_.size() - 1);
+}
+
+void MaterialTable::Clear() {
+    materials_.clear();
+    textures_.clear();
+    material_ids_.clear();
+    texture_ids_.clear();
+}
+
+// ---------------- Facade conversion ----------------
+
+MaterialRecord Lambertian::Record(MaterialTable& table) const {
+    MaterialRecord r;
+    r.type = MaterialType::kLambertian;
+    r.texture = table.AddTexture(tex_.get());
+    return r;
+}
+
+MaterialRecord Metal::Record(MaterialTable&) const {
+    MaterialRecord r;
+    r.type = MaterialType::kMetal;
+    r.albedo = albedo_;
+    r.fuzz = fuzz_;
+    return r;
+}
+
+MaterialRecord Dielectric::Record(MaterialTable&) const {
+    MaterialRecord r;
+    r.type = MaterialType::kDielectric;
+    r.ior = ref_idx_;
+    return r;
+}
+
+MaterialRecord DiffuseLight::Record(MaterialTable& table) const {
+    MaterialRecord r;
+    r.type = MaterialType::kDiffuseLight;
+    r.texture = table.AddTexture(emit_.get());
+    return r;
+}
+
+TextureRecord SolidColor::Record(MaterialTable&) const {
+    TextureRecord r;
+    r.type = TextureType::kSolid;
+    r.color = albedo_;
+    return r;
+}
+
+TextureRecord CheckerTexture::Record(MaterialTable& table) const {
+    TextureRecord r;
+    r.type = TextureType::kChecker;
+    r.inv_scale = inv_scale_;
+    r.even = table.AddTexture(even_.get());
+    r.odd = table.AddTexture(odd_.get());
+    return r;
+}
+
+TextureRecord ImageTexture::Record(MaterialTable&) const {
+    TextureRecord r;
+    r.type = TextureType::kImage;
+    r.image = image_.get();
+    return r;
+}
+
+// ---------------- Shading ----------------
+
+bool MaterialTable::IsSpecular(uint32_t mat_id) const {
+    // lights are treated specially, like DiffuseLight::IsSpecular
+    return materials_[mat_id].type != MaterialType::kLambertian;
+}
+
+core::Color MaterialTable::EvalTexture(uint32_t tex_id, double u, double v, const core::Point3& p,
+                                       double du, double dv) const {
+    // checker chains are followed iteratively
+    while (true) {
+        const TextureRecord& t = textures_[tex_id];
+        switch (t.type) {
+            case TextureType::kSolid:
+                return t.color;
+
+            case TextureType::kChecker: {
+                auto xInteger = int(std::floor(t.inv_scale * p.x()));
+                auto yInteger = int(std::floor(t.inv_scale * p.y()));
+                auto zInteger = int(std::floor(t.inv_scale * p.z()));
+                bool isEven = (xInteger + yInteger + zInteger) % 2 == 0;
+                tex_id = isEven ? t.even : t.odd;
+                break;
+            }
+
+            case TextureType::kImage:
+                return ImageTexture::Lookup(*t.image, u, v, du, dv);
+        }
+    }
+}
+
+core::Color MaterialTable::Emitted(const geom::HitRecord& rec) const {
+    const MaterialRecord& m = materials_[rec.mat_id];
+    if (m.type != MaterialType::kDiffuseLight)
+        return core::Color(0,0,0);
+    return EvalTexture(m.texture, rec.u, rec.v, rec.p);
+}
+
+core::Color MaterialTable::Eval(const geom::HitRecord& rec, const core::Vec3& wi, const core::Vec3&) const {
+    const MaterialRecord& m = materials_[rec.mat_id];
+    if (m.type != MaterialType::kLambertian)
+        return core::Color(0,0,0);  // delta lobes / emitters
+    return EvalLambertian(EvalTexture(m.texture, rec.u, rec.v, rec.p), rec, wi);
+}
+
+float MaterialTable::Pdf(const geom::HitRecord& rec, const core::Vec3& wi, const core::Vec3&) const {
+    const MaterialRecord& m = materials_[rec.mat_id];
+    if (m.type != MaterialType::kLambertian)
+        return 0.0f;
+    return PdfLambertian(rec, wi);
+}
+
+bool MaterialTable::Sample(
+    const geom::HitRecord& rec,
+    const core::Vec3& wo,
+    core::Vec3& wi,
+    float& pdf,
+    core::Color& f
+) const {
+    const MaterialRecord& m = materials_[rec.mat_id];
+    switch (m.type) {
+        case MaterialType::kLambertian:
+            return SampleLambertian(EvalTexture(m.texture, rec.u, rec.v, rec.p), rec, wi, pdf, f);
+        case MaterialType::kMetal:
+            return SampleMetal(m.albedo, m.fuzz, rec, wo, wi, pdf, f);
+        case MaterialType::kDielectric:
+            return SampleDielectric(m.ior, rec, wo, wi, pdf, f);
+        case MaterialType::kDiffuseLight:
+            return false;
+    }
+    return false;
+}
+
+} // namespace rt::material
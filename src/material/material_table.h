@@ -0,0 +1,77 @@
+#pragma once
+
+#include "core/color.h"
+#include "core/vec3.h"
+
+#include "material_record.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace rt::geom { class HitRecord; }
+
+namespace rt::material {
+
+class Material;
+class Texture;
+
+// Scene-owned, contiguous material and texture storage.
+// Primitives hold the id of their material (HitRecord::mat_id) and shading
+// is a switch on the record type, so the hot path does no virtual calls,
+// no shared_ptr copies and no pointer chasing through texture chains.
+class MaterialTable {
+public:
+    // registers a material (and the textures it references), returns its id
+    // the same object is only stored once
+    uint32_t Add(const Material* mat);
+    uint32_t AddTexture(const Texture* tex);
+
+    // appends records that have no facade object (scene bundles), ids inside
+    // them must already refer to this table
+    uint32_t AddRecord(const MaterialRecord& record);
+    uint32_t AddTextureRecord(const TextureRecord& record);
+
+    void Clear();
+
+    size_t size() const { return materials_.size(); }
+    bool   empty() const { return materials_.empty(); }
+
+    const MaterialRecord& operator[](uint32_t id) const { return materials_[id]; }
+    const TextureRecord&  texture(uint32_t id) const { return textures_[id]; }
+
+    const std::vector<MaterialRecord>& materials() const { return materials_; }
+    const std::vector<TextureRecord>&  textures() const { return textures_; }
+
+    // ---- shading, dispatched on rec.mat_id ----
+
+    bool IsSpecular(uint32_t mat_id) const;
+
+    // du, dv: uv footprint for filtered (mip mapped) image lookups
+    core::Color EvalTexture(uint32_t tex_id, double u, double v, const core::Point3& p,
+                            double du = 0.0, double dv = 0.0) const;
+
+    core::Color Emitted(const geom::HitRecord& rec) const;
+
+    core::Color Eval(const geom::HitRecord& rec, const core::Vec3& wi, const core::Vec3& wo) const;
+
+    float Pdf(const geom::HitRecord& rec, const core::Vec3& wi, const core::Vec3& wo) const;
+
+    bool Sample(
+        const geom::HitRecord& rec,
+        const core::Vec3& wo,
+        core::Vec3& wi,
+        float& pdf,
+        core::Color& f
+    ) const;
+
+private:
+    std::vector<MaterialRecord> materials_;
+    std::vector<TextureRecord>  textures_;
+
+    // build-time only, maps facade objects to ids
+    std::unordered_map<const Material*, uint32_t> material_ids_;
+    std::unordered_map<const Texture*, uint32_t>  texture_ids_;
+};
+
+} // namespace rt::material
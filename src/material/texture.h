@@ -3,7 +3,12 @@
 #include "core/color.h"
 #include "core/interval.h"
 
+#include "material_record.h"
+
 #include "scene/image.h"
+#include "scene/texture_cache.h"
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
 namespace rt::material {
@@ -13,6 +18,9 @@ public:
     virtual ~Texture() = default;
 
     virtual core::Color Value(double u, double v, const core::Point3& p) const = 0;
+
+    // plain-data form for the MaterialTable, registers child textures
+    virtual TextureRecord Record(MaterialTable& table) const = 0;
 };
 
 class SolidColor : public Texture {
@@ -24,6 +32,8 @@ public:
     core::Color Value(double u, double v, const core::Point3& p) const override {
         return albedo_;
     }
+    TextureRecord Record(MaterialTable& table) const override;
+
 private:
     core::Color albedo_;
 };
@@ -46,6 +56,8 @@ public:
         return isEven ? even_->Value(u, v, p) : odd_->Value(u, v, p);
     }
 
+    TextureRecord Record(MaterialTable& table) const override;
+
 private:
     double inv_scale_;
     std::shared_ptr<Texture> even_;
@@ -54,26 +66,40 @@ private:
 
 class ImageTexture : public Texture {
 public:
-    ImageTexture(const char* filename) : image_(filename) {}
+    // images come from the shared TextureCache, one copy per file
+    // hdr keeps float texels instead of 8 bit sRGB
+    ImageTexture(const char* filename, bool hdr = false)
+        : image_(scene::TextureCache::Global().Get(filename, hdr)) {}
 
     core::Color Value(double u, double v, const core::Point3& p) const override {
+        return Lookup(*image_, u, v);
+    }
+
+    // nearest texel lookup, shared with MaterialTable::EvalTexture
+    // du, dv is the uv footprint of the lookup; it picks the mip level whose
+    // texels are about that size (0 = full resolution)
+    static core::Color Lookup(const scene::Image& image, double u, double v, double du = 0.0, double dv = 0.0) {
         // If we have no texture data, then return solid cyan as a debugging aid.
-        if (image_.Height() <= 0) return core::Color(0,1,1);
+        if (image.Height() <= 0) return core::Color(0,1,1);
 
         // Clamp input texture coordinates to [0,1] x [1,0]
         u = core::Interval(0,1).Clamp(u);
         v = 1.0 - core::Interval(0,1).Clamp(v);  // Flip V to image coordinates
 
-        auto i = int(u * image_.Width());
-        auto j = int(v * image_.Height());
-        auto pixel = image_.PixelData(i,j);
+        int level = 0;
+        double texels = std::fmax(du * image.Width(), dv * image.Height());
+        if (texels > 1.0)
+            level = std::min(int(std::log2(texels) + 0.5), image.Levels() - 1);
 
-        auto color_scale = 1.0 / 255.0;
-        return core::Color(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
+        auto i = int(u * image.Width(level));
+        auto j = int(v * image.Height(level));
+        return image.Texel(i, j, level);
     }
 
+    TextureRecord Record(MaterialTable& table) const override;
+
 private:
-    scene::Image image_;
+    std::shared_ptr<const scene::Image> image_;
 };
 
 } // namespace rt::material
@@ -0,0 +1,118 @@
+#include "renderer/aov.h"
+
+#include "core/math_utils.h"
+
+#include <iostream>
+#include <sstream>
+
+namespace rt::renderer {
+
+namespace {
+
+constexpr Aov kAllAovs[] = {
+    Aov::kDepth, Aov::kNormal, Aov::kAlbedo, Aov::kPrimId, Aov::kMatId, Aov::kSamples, Aov::kVariance,
+};
+
+core::Color Id(uint32_t id) {
+    const double v = id == GBuffer::kNoId ? -1.0 : double(id);
+    return core::Color(v, v, v);
+}
+
+}  // namespace
+
+const char* AovName(Aov aov) {
+    switch (aov) {
+        case Aov::kDepth:    return "depth";
+        case Aov::kNormal:   return "normal";
+        case Aov::kAlbedo:   return "albedo";
+        case Aov::kPrimId:   return "primid";
+        case Aov::kMatId:    return "matid";
+        case Aov::kSamples:  return "samples";
+        case Aov::kVariance: return "variance";
+    }
+    return "";
+}
+
+bool ParseAovs(const std::string& list, std::vector<Aov>& aovs) {
+    aovs.clear();
+    if (list == "all") {
+        aovs.assign(std::begin(kAllAovs), std::end(kAllAovs));
+        return true;
+    }
+
+    std::istringstream in(list);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        bool known = false;
+        for (Aov aov : kAllAovs) {
+            if (name == AovName(aov)) {
+                aovs.push_back(aov);
+                known = true;
+                break;
+            }
+        }
+        if (!known) {
+            std::cerr << "ERROR: Unknown AOV '" << name << "'\n";
+            return false;
+        }
+    }
+    return !aovs.empty();
+}
+
+bool NeedsGuides(const std::vector<Aov>& aovs) {
+    for (Aov aov : aovs) {
+        if (aov != Aov::kSamples && aov != Aov::kVariance)
+            return true;
+    }
+    return false;
+}
+
+std::string AovPath(const std::string& output, Aov aov) {
+    const size_t slash = output.find_last_of('/');
+    const size_t dot = output.find_last_of('.');
+    const std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash)
+        ? output.substr(0, dot) : output;
+    return stem + "." + AovName(aov) + ".pfm";
+}
+
+void AovImage(Aov aov, const std::vector<integrator::PixelState>& pixels, const GBuffer& guides,
+              int width, int height, std::vector<core::Color>& out) {
+    const size_t n = size_t(width) * height;
+    out.assign(n, core::Color(0,0,0));
+    if (pixels.size() < n || (NeedsGuides({ aov }) && guides.count.size() < n))
+        return;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < int(n); ++i) {
+        const integrator::PixelState& ps = pixels[i];
+        switch (aov) {
+            case Aov::kDepth: {
+                const double d = guides.Depth(i);
+                out[i] = core::Color(d, d, d);
+                break;
+            }
+            case Aov::kNormal: {
+                const core::Vec3 nrm = guides.Normal(i);
+                out[i] = nrm.length() > 0 ? core::Normalize(nrm) : nrm;
+                break;
+            }
+            case Aov::kAlbedo:
+                out[i] = guides.Albedo(i);
+                break;
+            case Aov::kPrimId:
+                out[i] = Id(guides.prim_id[i]);
+                break;
+            case Aov::kMatId:
+                out[i] = Id(guides.mat_id[i]);
+                break;
+            case Aov::kSamples:
+                out[i] = core::Color(ps.samples, ps.samples, ps.samples);
+                break;
+            case Aov::kVariance:
+                out[i] = ps.samples > 0 ? integrator::Variance(ps) / ps.samples : core::Color(0,0,0);
+                break;
+        }
+    }
+}
+
+}  // namespace rt::renderer
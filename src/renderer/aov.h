@@ -0,0 +1,49 @@
+#pragma once
+
+#include "core/color.h"
+#include "integrator/pixel_state.h"
+#include "renderer/gbuffer.h"
+
+#include <string>
+#include <vector>
+
+namespace rt::renderer {
+
+// Arbitrary output variables written alongside the beauty image. All of them
+// come out of the same render: the first hit ones from the GBuffer, the
+// statistics from the per pixel Welford state.
+//
+//   kDepth:    distance to the first hit, 0 where the camera ray escapes
+//   kNormal:   first hit shading normal, components in [-1, 1]
+//   kAlbedo:   first hit reflectance (see GBuffer)
+//   kPrimId:   top level primitive id, -1 on a miss
+//   kMatId:    MaterialTable id, -1 on a miss
+//   kSamples:  samples taken
+//   kVariance: variance of the pixel's mean, per channel
+enum class Aov {
+    kDepth,
+    kNormal,
+    kAlbedo,
+    kPrimId,
+    kMatId,
+    kSamples,
+    kVariance,
+};
+
+const char* AovName(Aov aov);
+
+// comma separated names as printed by AovName, or "all"; false on an
+// unknown name
+bool ParseAovs(const std::string& list, std::vector<Aov>& aovs);
+
+// whether any of them needs the GBuffer collected during the render
+bool NeedsGuides(const std::vector<Aov>& aovs);
+
+// next to the beauty image and always float: out.png -> out.depth.pfm
+std::string AovPath(const std::string& output, Aov aov);
+
+// one AOV as an image, scalars repeated in all three channels
+void AovImage(Aov aov, const std::vector<integrator::PixelState>& pixels, const GBuffer& guides,
+              int width, int height, std::vector<core::Color>& out);
+
+}  // namespace rt::renderer
@@ -0,0 +1,155 @@
+#include "renderer/checkpoint.h"
+
+#include "scene/camera.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace rt::renderer {
+
+namespace {
+
+constexpr char     kCheckpointMagic[8] = { 'R', 'T', 'C', 'H', 'E', 'C', 'K', 'P' };
+constexpr uint32_t kCheckpointVersion  = 2;
+
+struct CheckpointHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t pixel_size;
+    int32_t  width;
+    int32_t  height;
+    uint32_t sample_mode;
+    int32_t  next_sample;
+    uint64_t key;          // CheckpointKey of the render
+};
+
+// PixelState with a fixed layout
+struct CheckpointPixel {
+    double   sum[3];
+    double   mean[3];
+    double   m2[3];
+    uint32_t samples;
+    uint32_t converged;
+};
+
+}  // namespace
+
+uint64_t CheckpointKey(const std::string& scene_path, const scene::CameraConfig& camera) {
+    scene::CameraConfig cfg = camera;
+    cfg.samples_per_pixel = 0;
+    const std::string text = scene_path + "\n" + scene::cameraToJson(cfg).dump();
+
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+bool WriteCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+    const std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary);
+    if (!out) {
+        std::cerr << "ERROR: Could not write checkpoint '" << path << "'\n";
+        return false;
+    }
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+    header.version = kCheckpointVersion;
+    header.pixel_size = sizeof(CheckpointPixel);
+    header.width = checkpoint.width;
+    header.height = checkpoint.height;
+    header.sample_mode = uint32_t(checkpoint.sample_mode);
+    header.next_sample = checkpoint.next_sample;
+    header.key = checkpoint.key;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<CheckpointPixel> rows(checkpoint.width);
+    for (int y = 0; y < checkpoint.height; ++y) {
+        for (int x = 0; x < checkpoint.width; ++x) {
+            const integrator::PixelState& ps = checkpoint.pixels[size_t(y) * checkpoint.width + x];
+            CheckpointPixel& p = rows[x];
+            for (int c = 0; c < 3; ++c) {
+                p.sum[c] = ps.sum[c];
+                p.mean[c] = ps.mean[c];
+                p.m2[c] = ps.m2[c];
+            }
+            p.samples = uint32_t(ps.samples);
+            p.converged = ps.converged;
+        }
+        out.write(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(CheckpointPixel));
+    }
+
+    out.close();
+    if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        std::cerr << "ERROR: Could not write checkpoint '" << path << "'\n";
+        return false;
+    }
+    return true;
+}
+
+bool ReadCheckpoint(const std::string& path, Checkpoint& checkpoint) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "ERROR: Could not open checkpoint '" << path << "'\n";
+        return false;
+    }
+
+    CheckpointHeader header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0 ||
+        header.version != kCheckpointVersion || header.pixel_size != sizeof(CheckpointPixel) ||
+        header.width <= 0 || header.height <= 0) {
+        std::cerr << "ERROR: '" << path << "' is not a checkpoint of this version\n";
+        return false;
+    }
+
+    checkpoint.width = header.width;
+    checkpoint.height = header.height;
+    checkpoint.sample_mode = core::SampleMode(header.sample_mode);
+    checkpoint.next_sample = header.next_sample;
+    checkpoint.key = header.key;
+
+    std::vector<CheckpointPixel> data(size_t(header.width) * header.height);
+    in.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(CheckpointPixel));
+    if (!in) {
+        std::cerr << "ERROR: Checkpoint '" << path << "' is truncated\n";
+        return false;
+    }
+
+    checkpoint.pixels.resize(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        integrator::PixelState& ps = checkpoint.pixels[i];
+        ps.sum = core::Color(data[i].sum[0], data[i].sum[1], data[i].sum[2]);
+        ps.mean = core::Color(data[i].mean[0], data[i].mean[1], data[i].mean[2]);
+        ps.m2 = core::Color(data[i].m2[0], data[i].m2[1], data[i].m2[2]);
+        ps.samples = int(data[i].samples);
+        ps.converged = data[i].converged != 0;
+    }
+    return true;
+}
+
+bool CheckpointWriter::Submit(const std::string& path, Checkpoint checkpoint) {
+    if (pending_.valid()) {
+        if (pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+        pending_.get();
+    }
+    pending_ = std::async(std::launch::async, [path, checkpoint = std::move(checkpoint)]() {
+        return WriteCheckpoint(path, checkpoint);
+    });
+    return true;
+}
+
+bool CheckpointWriter::Wait() {
+    return !pending_.valid() || pending_.get();
+}
+
+}  // namespace rt::renderer
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "core/random.h"
+#include "integrator/pixel_state.h"
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace rt::scene {
+struct CameraConfig;
+}
+
+namespace rt::renderer {
+
+// Render checkpoints (.rtc).
+//
+// A checkpoint is the PixelState of every pixel (sum, mean, M2, sample count,
+// converged flag) after a number of whole sample passes. Random numbers are a
+// hash of (pixel, sample, bounce) in the camera's sample mode, so the RNG
+// state is just the sample mode and the next sample index: a resumed render
+// continues exactly where the checkpointed one would have.
+//
+// The key identifies the render a checkpoint belongs to, see CheckpointKey;
+// statistics of a different scene or view are never merged.
+struct Checkpoint {
+    int width = 0;
+    int height = 0;
+    core::SampleMode sample_mode = core::SampleMode::kSobol;
+    uint64_t key = 0;
+    int next_sample = 0;
+    std::vector<integrator::PixelState> pixels;
+};
+
+// hash of the scene path and every camera setting except samplesPerPixel,
+// which a resume may raise to add samples to a finished render
+uint64_t CheckpointKey(const std::string& scene_path, const scene::CameraConfig& camera);
+
+// written under a temporary name and renamed, so a crash mid-write keeps
+// the previous checkpoint
+bool WriteCheckpoint(const std::string& path, const Checkpoint& checkpoint);
+
+bool ReadCheckpoint(const std::string& path, Checkpoint& checkpoint);
+
+// Writes checkpoints on a background thread, one at a time. Render threads
+// only pay for the snapshot copy; if the previous write is still running the
+// new snapshot is dropped instead of waiting for the disk.
+class CheckpointWriter {
+public:
+    ~CheckpointWriter() { Wait(); }
+
+    // false if skipped because a write is in flight
+    bool Submit(const std::string& path, Checkpoint checkpoint);
+
+    // waits for the write in flight; false if it failed
+    bool Wait();
+
+private:
+    std::future<bool> pending_;
+};
+
+}  // namespace rt::renderer
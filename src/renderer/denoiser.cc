@@ -0,0 +1,257 @@
+#include "renderer/denoiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace rt::renderer {
+
+namespace {
+
+constexpr float kKernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+constexpr float kAlbedoFloor = 1e-3f;  // keeps demodulation invertible on black surfaces
+constexpr float kMaxExponent = 30.0f;  // luminance and depth weights end at e^-30
+constexpr float kMinWeight = 1e-12f;   // smaller tap weights are dropped
+
+// e^x for -87 <= x <= 0, relative error below 1e-5. Straight-line float and
+// integer arithmetic, so loops calling it vectorize; a clamp on x here would
+// get the loop body duplicated into branches, so callers clamp instead.
+inline float FastExp(float x) {
+    const float t = x * 1.442695041f;  // log2(e)
+    int i = static_cast<int>(t);       // rounds toward 0,
+    i -= t < static_cast<float>(i);    // floor
+    const float f = t - static_cast<float>(i);
+    const float p = 1.0f + f * (0.6931472f + f * (0.2402265f + f * (0.0555041f + f * (0.0096181f + f * 0.0013333f))));
+    const int32_t bits = (std::max(i, -127) + 127) << 23;  // 0 below the normal range
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// dot(n_p, n_q)^128 as in SVGF, squared out by hand so the caller stays a
+// single basic block. Below 0.75 the weight is under 1e-16 and is cut to 0,
+// which keeps the squares out of the (very slow) denormal range.
+inline float NormalWeight(float d) {
+    d = d > 0.75f ? d : 0.0f;
+    d *= d; d *= d; d *= d; d *= d;
+    d *= d; d *= d; d *= d;
+    return d;
+}
+
+inline float Luminance(float r, float g, float b) {
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// one image worth of float planes
+struct Planes {
+    std::vector<float> r, g, b;
+    std::vector<float> var;  // variance of the luminance estimate
+
+    void Resize(size_t n) {
+        r.resize(n);
+        g.resize(n);
+        b.resize(n);
+        var.resize(n);
+    }
+};
+
+struct Guides {
+    std::vector<float> nx, ny, nz, z;
+};
+
+struct Level {
+    int width, height, step;
+    float sigma_l, sigma_z;
+};
+
+// scratch sums of one row
+struct RowSums {
+    std::vector<float> w, r, g, b, v;
+    std::vector<float> lum, inv_sl;  // center pixel terms
+
+    void Resize(size_t n) {
+        w.assign(n, 0.0f);
+        r.assign(n, 0.0f);
+        g.assign(n, 0.0f);
+        b.assign(n, 0.0f);
+        v.assign(n, 0.0f);
+        lum.resize(n);
+        inv_sl.resize(n);
+    }
+};
+
+// One tap for pixels x0..x1 of row `base`, pixel x reading q = shift + x.
+// A straight loop over float planes that the compiler vectorizes.
+void AccumulateTap(const Planes& in, const std::vector<float>& lum, const Guides& gd,
+                   int base, int x0, int x1, int shift, float h, float z_scale, RowSums& row) {
+    const float* nx = gd.nx.data();
+    const float* ny = gd.ny.data();
+    const float* nz = gd.nz.data();
+    const float* z = gd.z.data();
+    const float* r = in.r.data();
+    const float* g = in.g.data();
+    const float* b = in.b.data();
+    const float* var = in.var.data();
+    const float* lq = lum.data();
+    const float* lp = row.lum.data();
+    const float* isl = row.inv_sl.data();
+    float* sw = row.w.data();
+    float* sr = row.r.data();
+    float* sg = row.g.data();
+    float* sb = row.b.data();
+    float* sv = row.v.data();
+
+    #pragma omp simd
+    for (int x = x0; x < x1; ++x) {
+        const int p = base + x;
+        const int q = shift + x;
+        const float wn = NormalWeight(nx[p] * nx[q] + ny[p] * ny[q] + nz[p] * nz[q]);
+        const float wz = std::abs(z[p] - z[q]) / (z_scale * std::max(z[p], z[q]) + 1e-4f);
+        const float wl = std::abs(lp[x] - lq[q]) * isl[x];
+        float wt = h * wn * FastExp(-std::min(wl + wz, kMaxExponent));
+        wt = wt > kMinWeight ? wt : 0.0f;  // so wt * wt stays a normal float
+        sw[x] += wt;
+        sr[x] += wt * r[q];
+        sg[x] += wt * g[q];
+        sb[x] += wt * b[q];
+        sv[x] += wt * wt * var[q];
+    }
+}
+
+// Filters row y. Taps are the outer loops and the pixels of the row the
+// inner one; the few pixels whose tap falls off the image read the clamped
+// edge pixel one at a time.
+void FilterRow(const Level& lv, const Planes& in, const std::vector<float>& lum, const std::vector<float>& blurred_var,
+               const Guides& gd, Planes& out, int y, RowSums& row) {
+    const int w = lv.width;
+    const int base = y * w;
+    row.Resize(w);
+    for (int x = 0; x < w; ++x) {
+        row.lum[x] = lum[base + x];
+        row.inv_sl[x] = 1.0f / (lv.sigma_l * std::sqrt(std::max(blurred_var[base + x], 0.0f)) + 1e-6f);
+    }
+
+    for (int dy = -2; dy <= 2; ++dy) {
+        const int qbase = std::clamp(y + dy * lv.step, 0, lv.height - 1) * w;
+        for (int dx = -2; dx <= 2; ++dx) {
+            const int off = dx * lv.step;
+            const float h = kKernel[dy + 2] * kKernel[dx + 2];
+            const float z_scale = lv.sigma_z * 0.02f * float(lv.step * std::max(std::abs(dx), std::abs(dy)));
+            const int x_lo = std::clamp(-off, 0, w);
+            const int x_hi = std::clamp(w - off, x_lo, w);
+            for (int x = 0; x < x_lo; ++x)
+                AccumulateTap(in, lum, gd, base, x, x + 1, qbase - x, h, z_scale, row);
+            AccumulateTap(in, lum, gd, base, x_lo, x_hi, qbase + off, h, z_scale, row);
+            for (int x = x_hi; x < w; ++x)
+                AccumulateTap(in, lum, gd, base, x, x + 1, qbase + w - 1 - x, h, z_scale, row);
+        }
+    }
+
+    // the center tap always has weight, sums are > 0
+    const float* sw = row.w.data();
+    for (int x = 0; x < w; ++x) {
+        const float inv = 1.0f / sw[x];
+        out.r[base + x] = row.r[x] * inv;
+        out.g[base + x] = row.g[x] * inv;
+        out.b[base + x] = row.b[x] * inv;
+        out.var[base + x] = row.v[x] * inv * inv;
+    }
+}
+
+// 3x3 gaussian of the variance, a steadier noise estimate for the weights
+void BlurVariance(const std::vector<float>& var, int width, int height, std::vector<float>& blurred) {
+    static constexpr float kGauss[3] = { 0.25f, 0.5f, 0.25f };
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float sum = 0.0f;
+            for (int dy = -1; dy <= 1; ++dy) {
+                const int yy = std::clamp(y + dy, 0, height - 1);
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const int xx = std::clamp(x + dx, 0, width - 1);
+                    sum += kGauss[dy + 1] * kGauss[dx + 1] * var[yy * width + xx];
+                }
+            }
+            blurred[y * width + x] = sum;
+        }
+    }
+}
+
+}  // namespace
+
+void Denoise(const std::vector<integrator::PixelState>& pixels, const GBuffer& guides,
+             int width, int height, std::vector<core::Color>& out, const DenoiseOptions& options) {
+    const size_t n = size_t(width) * height;
+    out.assign(n, core::Color(0,0,0));
+    if (n == 0 || pixels.size() < n || guides.count.size() < n)
+        return;
+
+    // demodulated lighting, its variance and the guides as float planes
+    Planes a, b;
+    a.Resize(n);
+    b.Resize(n);
+    Guides gd;
+    gd.nx.resize(n);
+    gd.ny.resize(n);
+    gd.nz.resize(n);
+    gd.z.resize(n);
+    std::vector<float> ar(n), ag(n), ab(n);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < int(n); ++i) {
+        const integrator::PixelState& ps = pixels[i];
+        const core::Color albedo = guides.Albedo(i);
+        ar[i] = std::max(float(albedo.x()), kAlbedoFloor);
+        ag[i] = std::max(float(albedo.y()), kAlbedoFloor);
+        ab[i] = std::max(float(albedo.z()), kAlbedoFloor);
+
+        const core::Color mean = ps.samples > 0 ? ps.sum / ps.samples : core::Color(0,0,0);
+        a.r[i] = float(mean.x()) / ar[i];
+        a.g[i] = float(mean.y()) / ag[i];
+        a.b[i] = float(mean.z()) / ab[i];
+
+        // variance of the mean's luminance, channels taken as independent
+        const core::Color var = integrator::Variance(ps);
+        const float vl = 0.2126f * 0.2126f * float(var.x()) / (ar[i] * ar[i]) +
+                         0.7152f * 0.7152f * float(var.y()) / (ag[i] * ag[i]) +
+                         0.0722f * 0.0722f * float(var.z()) / (ab[i] * ab[i]);
+        a.var[i] = ps.samples > 0 ? vl / ps.samples : 0.0f;
+
+        const core::Vec3 normal = guides.Normal(i);
+        const double len = normal.length();
+        gd.nx[i] = len > 0 ? float(normal.x() / len) : 0.0f;
+        gd.ny[i] = len > 0 ? float(normal.y() / len) : 0.0f;
+        gd.nz[i] = len > 0 ? float(normal.z() / len) : 0.0f;
+        gd.z[i] = guides.Depth(i);
+    }
+
+    std::vector<float> blurred(n);
+    std::vector<float> lum(n);
+    Planes* in = &a;
+    Planes* dst = &b;
+    for (int it = 0; it < options.iterations; ++it) {
+        const Level lv{ width, height, 1 << it, options.sigma_luminance, options.sigma_depth };
+        BlurVariance(in->var, width, height, blurred);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < int(n); ++i)
+            lum[i] = Luminance(in->r[i], in->g[i], in->b[i]);
+
+        #pragma omp parallel
+        {
+            RowSums row;
+            #pragma omp for schedule(static)
+            for (int y = 0; y < height; ++y)
+                FilterRow(lv, *in, lum, blurred, gd, *dst, y, row);
+        }
+        std::swap(in, dst);
+    }
+
+    // back to radiance
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < int(n); ++i) {
+        out[i] = core::Color(in->r[i] * ar[i], in->g[i] * ag[i], in->b[i] * ab[i]);
+    }
+}
+
+}  // namespace rt::renderer
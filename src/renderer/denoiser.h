@@ -0,0 +1,33 @@
+#pragma once
+
+#include "core/color.h"
+#include "integrator/pixel_state.h"
+#include "renderer/gbuffer.h"
+
+#include <vector>
+
+namespace rt::renderer {
+
+struct DenoiseOptions {
+    int   iterations = 5;          // filter levels, the last one reaches 64 pixels out
+    float sigma_luminance = 4.0f;  // in standard deviations of the pixel's estimate
+    float sigma_depth = 1.0f;      // in 2% of depth per pixel of distance
+};
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) with the
+// variance-guided luminance weight of SVGF (Schied et al. 2017).
+//
+// The image is divided by the first-hit albedo, so textures are kept sharp
+// and only lighting is filtered, then blurred with a 5x5 B3 spline kernel at
+// strides 1, 2, 4, ... Each tap is weighted by how well its normal and depth
+// match and by how far its luminance lies outside the pixel's own noise,
+// estimated from the per-pixel Welford variance and filtered along with the
+// image. Works on float planes, rows in parallel, with the pixels of a row
+// as the innermost loop so the taps vectorize.
+//
+// pixels: per pixel statistics of a render; guides: its GBuffer.
+void Denoise(const std::vector<integrator::PixelState>& pixels, const GBuffer& guides,
+             int width, int height, std::vector<core::Color>& out,
+             const DenoiseOptions& options = DenoiseOptions());
+
+}  // namespace rt::renderer
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "core/color.h"
+#include "core/math_utils.h"
+#include "core/ray.h"
+#include "core/vec3.h"
+#include "geom/hittable.h"
+#include "material/material_table.h"
+#include "integrator/path_integrator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace rt::renderer {
+
+// First-hit surface attributes of every pixel, summed over its samples.
+// They are read off the primary rays' intersections, so collecting them
+// traces nothing extra. The denoiser uses them as edge-stopping guides and
+// they are written out as AOVs (renderer/aov.h).
+//
+// Rays that leave the scene record the background as albedo, the reversed
+// ray direction as normal and depth 0, so open sky stays smooth. Ids cannot
+// be averaged: a pixel keeps those of its first sample, kNoId on a miss.
+struct GBuffer {
+    std::vector<core::Color> albedo;
+    std::vector<core::Vec3>  normal;
+    std::vector<float>       depth;   // distance along the camera ray
+    std::vector<uint32_t>    count;   // samples recorded
+    std::vector<uint32_t>    prim_id; // top level primitive of the first sample
+    std::vector<uint32_t>    mat_id;  // its MaterialTable id
+
+    static constexpr uint32_t kNoId = UINT32_MAX;
+
+    bool empty() const { return count.empty(); }
+
+    void Resize(size_t pixels) {
+        albedo.assign(pixels, core::Color(0,0,0));
+        normal.assign(pixels, core::Vec3(0,0,0));
+        depth.assign(pixels, 0.0f);
+        count.assign(pixels, 0);
+        prim_id.assign(pixels, kNoId);
+        mat_id.assign(pixels, kNoId);
+    }
+
+    void Clear(size_t i) {
+        albedo[i] = core::Color(0,0,0);
+        normal[i] = core::Vec3(0,0,0);
+        depth[i] = 0.0f;
+        count[i] = 0;
+        prim_id[i] = kNoId;
+        mat_id[i] = kNoId;
+    }
+
+    // called once per primary ray; a pixel has one primary ray in flight at
+    // a time, so this needs no locking
+    void Record(size_t i, const core::Ray& r, const geom::HitRecord& rec, const material::MaterialTable& materials) {
+        if (count[i]++ == 0 && rec.hit) {
+            prim_id[i] = rec.prim_id;
+            mat_id[i] = rec.mat_id;
+        }
+        if (!rec.hit) {
+            albedo[i] += integrator::Background(r);
+            normal[i] += -core::Normalize(r.direction());
+            return;
+        }
+
+        const material::MaterialRecord& m = materials[rec.mat_id];
+        core::Color a(1,1,1);  // dielectric: passes everything
+        switch (m.type) {
+            case material::MaterialType::kLambertian:
+                a = materials.EvalTexture(m.texture, rec.u, rec.v, rec.p);
+                break;
+            case material::MaterialType::kMetal:
+                a = m.albedo;
+                break;
+            case material::MaterialType::kDiffuseLight: {
+                const core::Color e = materials.EvalTexture(m.texture, rec.u, rec.v, rec.p);
+                a = core::Color(std::min(e.x(), 1.0), std::min(e.y(), 1.0), std::min(e.z(), 1.0));
+                break;
+            }
+            case material::MaterialType::kDielectric:
+                break;
+        }
+        albedo[i] += a;
+        normal[i] += core::Normalize(rec.normal);
+        depth[i] += static_cast<float>(rec.t * r.direction().length());
+    }
+
+    // averages over the recorded samples
+    core::Color Albedo(size_t i) const { return count[i] ? albedo[i] / count[i] : core::Color(0,0,0); }
+    core::Vec3  Normal(size_t i) const { return count[i] ? normal[i] / count[i] : core::Vec3(0,0,0); }
+    float       Depth(size_t i) const { return count[i] ? depth[i] / count[i] : 0.0f; }
+};
+
+}  // namespace rt::renderer
@@ -0,0 +1,89 @@
+#include "renderer/mega_kernel.h"
+
+#include "integrator/path_integrator.h"
+#include "scene/camera.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+#include <iostream>
+#include <omp.h>
+
+namespace rt::renderer {
+
+MegaKernel::MegaKernel(
+    const scene::Scene& world,
+    const scene::Camera& cam,
+    int max_depth,
+    int max_samples
+)
+    : world_(world)
+    , cam_(cam)
+    , max_depth_(max_depth)
+    , max_samples_(max_samples)
+{}
+
+void MegaKernel::Render() {
+
+    // the wavefront renderer's adaptive test
+    const float kRelThresh  = 0.05;
+    const int   kMinSamples = 16;
+
+    const material::MaterialTable& materials = world_.Materials();
+
+    const int width  = cam_.get_image_width();
+    const int height = cam_.get_image_height();
+    const int npix   = width * height;
+
+    const int x0 = std::clamp(region_[0], 0, width);
+    const int y0 = std::clamp(region_[1], 0, height);
+    const int x1 = region_[2] < 0 ? width : std::clamp(region_[2], x0, width);
+    const int y1 = region_[3] < 0 ? height : std::clamp(region_[3], y0, height);
+    const int s0 = std::max(sample_begin_, 0);
+    const int s1 = sample_end_ < 0 ? max_samples_ : std::min(sample_end_, max_samples_);
+
+    // like the wavefront's, buffers are kept between renders of the same
+    // size and only the region starts over
+    if ((int)pixels_.size() != npix) {
+        pixels_.assign(npix, integrator::PixelState{});
+        framebuffer_.assign(npix, core::Color(0,0,0));
+    }
+
+    long total_samples = 0;
+    uint64_t rays = 0;
+    auto stopped = [this] { return stop_flag_ && stop_flag_->load(std::memory_order_relaxed); };
+
+    #pragma omp parallel for schedule(dynamic) reduction(+:total_samples, rays)
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            const int idx = y * width + x;
+            integrator::PixelState& ps = pixels_[idx];
+            ps = integrator::PixelState{};
+
+            for (int s = s0; s < s1 && !ps.converged && !(s > s0 && stopped()); ++s) {
+                const integrator::RayState rs = integrator::CameraRay(cam_, x, y, idx, s);
+                int path_rays = 0;
+                integrator::RecordSample(ps, integrator::TracePath(world_, materials, rs, max_depth_, cam_.sample_mode_, path_rays));
+                rays += path_rays;
+                if (integrator::IsConverged(ps, kRelThresh, kMinSamples))
+                    ps.converged = true;
+            }
+
+            total_samples += ps.samples;
+            framebuffer_[idx] = ps.samples > 0 ? ps.sum / (float)ps.samples : core::Color(0,0,0);
+        }
+    }
+    rays_traced_ = rays;
+
+    if (stopped())
+        std::clog << "Stopped: pixels left took one sample each\n";
+
+    std::clog << "Mega-kernel: " << total_samples << " samples, "
+              << double(total_samples) / std::max((x1 - x0) * (y1 - y0), 1) << " per pixel\n";
+}
+
+void MegaKernel::ReleaseBuffers() {
+    std::vector<integrator::PixelState>().swap(pixels_);
+    std::vector<core::Color>().swap(framebuffer_);
+}
+
+} // namespace rt::renderer
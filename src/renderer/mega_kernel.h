@@ -1,61 +1,68 @@
 #pragma once
 
-#include "scene/scene.h"
-#include "scene/camera.h"
+#include <vector>
 
-#include "integrator/sampler.h"
+#include "core/color.h"
+#include "integrator/pixel_state.h"
+#include "renderer/renderer.h"
+
+namespace rt::scene {
+class Scene;
+class Camera;
+}
 
 namespace rt::renderer {
 
-class MegaKernel {
+// Mega-kernel renderer: every thread takes whole rows and traces each of
+// a pixel's paths from camera to end with integrator::TracePath before the
+// next, so there are no ray queues, batches or bucket passes. It uses the
+// wavefront renderer's integrator, random streams and adaptive convergence
+// test, so both give the same image and compare on speed alone; passes,
+// budgets, guiding and the other wavefront features are not available.
+class MegaKernel : public Renderer {
 public:
-    MegaKernel(scene::Scene& scene, scene::Camera& camera, integrator::Sampler& sampler)
-        : sampler_(sampler), world_(scene), cam_(camera) {}
-
-    void Render() {
-        cam_.Initialize();
-        int width = cam_.get_image_width();
-        int height = cam_.get_image_height();
-        long total_samples = 0;
-
-        std::vector<core::Color> framebuffer(width * height);
-
-        #pragma omp parallel for schedule(dynamic)
-        for( int y = 0; y < height; y++ ) {
-            
-            int thread_id = omp_get_thread_num();
-
-            // atomic progress logging
-            #pragma omp critical
-            {
-                std::clog << "\rThread " << thread_id
-                    << " processing scanline: " << y
-                    << " (" << height - y << " remaining) "
-                    << std::flush;
-            }
-
-            for( int x = 0; x < width; x++ ) {
-                // aquire pixel color using sampler
-                core::Color pixel_color;
-                int num_samples = sampler_.SamplePixel(pixel_color, world_, cam_, x, y);
-                total_samples += num_samples;
-
-                // add color to framebuffer
-                framebuffer[y * width + x] = pixel_color;
-            }
-        }
-
-        std::cout << "P3\n" << width << ' ' << height << "\n255\n";
-        for( auto& c: framebuffer ) {
-            write_color(std::cout, c); 
-        }
-
-        std::clog << "\rDone. Total samples: " << total_samples << "Per pixel: " << total_samples / (width * height) <<"\n";
-    }
+    MegaKernel(
+        const scene::Scene&  world,
+        const scene::Camera& cam,
+        int max_depth   = 10,
+        int max_samples = 128
+    );
+
+    const char* Name() const override { return "mega-kernel"; }
+
+    void SetRegion(int x0, int y0, int x1, int y1) override { region_[0] = x0; region_[1] = y0; region_[2] = x1; region_[3] = y1; }
+    void SetSampleRange(int begin, int end) override { sample_begin_ = begin; sample_end_ = end; }
+
+    void Render() override;
+
+    // Pixels are rendered one after another, so there is no pass to finish:
+    // once *stop is set every pixel still to come, and the rest of one being
+    // rendered, takes a single sample, about the cost of one wavefront pass.
+    // The image is complete, only noisier where the stop cut in.
+    void SetStopFlag(const std::atomic<bool>* stop) override { stop_flag_ = stop; }
+
+    uint64_t RaysTraced() const override { return rays_traced_; }
+
+    const std::vector<integrator::PixelState>& Pixels() const override { return pixels_; }
+    const std::vector<core::Color>& Framebuffer() const override { return framebuffer_; }
+
+    void ReleaseBuffers() override;
+
 private:
-    integrator::Sampler& sampler_;
-    scene::Scene& world_;
-    scene::Camera& cam_;
+    const scene::Scene&  world_;
+    const scene::Camera& cam_;
+
+    int max_depth_;
+    int max_samples_;
+
+    int region_[4] = { 0, 0, -1, -1 };
+    int sample_begin_ = 0;
+    int sample_end_ = -1;
+    uint64_t rays_traced_ = 0;
+    const std::atomic<bool>* stop_flag_ = nullptr;
+
+    std::vector<integrator::PixelState> pixels_;
+    std::vector<core::Color> framebuffer_;
 };
 
 } // namespace rt::renderer
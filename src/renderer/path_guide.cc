@@ -0,0 +1,197 @@
+#include "renderer/path_guide.h"
+
+#include "core/constants.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rt::renderer {
+
+namespace {
+
+// a leaf is split once an iteration puts more than this x sqrt(2^iteration)
+// vertices into it (the SD-tree's rule, scaled to our pass sizes)
+constexpr double kSplitVertices = 4000.0;
+constexpr int    kMaxDepth = 24;
+
+}  // namespace
+
+PathGuide::PathGuide(const geom::Aabb& bounds, size_t pixels)
+    : bounds_(bounds)
+    , nodes_(1)
+    , cdf_(kBins, 0.0f)
+    , trained_(1, 0)
+    , sums_(kBins)
+    , counts_(1)
+    , vertices_(pixels * kMaxVertices)
+    , vertex_count_(pixels, 0)
+{}
+
+uint32_t PathGuide::Leaf(const core::Point3& p) const {
+    int n = 0;
+    while (nodes_[n].child >= 0) {
+        const Node& node = nodes_[n];
+        n = node.child + (p[node.axis] < node.split ? 0 : 1);
+    }
+    return nodes_[n].leaf;
+}
+
+int PathGuide::Bin(const core::Vec3& dir) {
+    const double cos_theta = std::clamp(dir.z(), -1.0, 1.0);
+    double phi = std::atan2(dir.y(), dir.x());
+    if (phi < 0.0)
+        phi += core::kTwoPi;
+    const int bx = std::min(static_cast<int>((cos_theta + 1.0) * 0.5 * kRes), kRes - 1);
+    const int by = std::min(static_cast<int>(phi * core::kInvTwoPi * kRes), kRes - 1);
+    return by * kRes + bx;
+}
+
+float PathGuide::Probability(uint32_t leaf, int bin) const {
+    const float* cdf = cdf_.data() + size_t(leaf) * kBins;
+    return cdf[bin] - (bin > 0 ? cdf[bin - 1] : 0.0f);
+}
+
+core::Vec3 PathGuide::Sample(uint32_t leaf, double u1, double u2, float& pdf) const {
+    const float* cdf = cdf_.data() + size_t(leaf) * kBins;
+    const int bin = std::min(static_cast<int>(std::upper_bound(cdf, cdf + kBins, float(u1)) - cdf), kBins - 1);
+    const float prob = Probability(leaf, bin);
+    pdf = prob * kBins / float(4.0 * core::kPi);
+
+    // the position of u1 inside the bin's range is the second coordinate
+    const float lower = bin > 0 ? cdf[bin - 1] : 0.0f;
+    const double frac = prob > 0.0f ? std::clamp((u1 - lower) / prob, 0.0, 1.0) : 0.5;
+
+    const double cos_theta = 2.0 * ((bin % kRes) + frac) / kRes - 1.0;
+    const double phi = core::kTwoPi * ((bin / kRes) + u2) / kRes;
+    const double sin_theta = std::sqrt(std::max(0.0, 1.0 - cos_theta * cos_theta));
+    return core::Vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+}
+
+float PathGuide::Pdf(uint32_t leaf, const core::Vec3& dir) const {
+    return Probability(leaf, Bin(dir)) * kBins / float(4.0 * core::kPi);
+}
+
+void PathGuide::BeginWave() {
+    std::fill(vertex_count_.begin(), vertex_count_.end(), 0);
+}
+
+void PathGuide::AddVertex(int pixel, uint32_t leaf, const core::Vec3& wi, float pdf, const core::Color& throughput) {
+    uint8_t& count = vertex_count_[pixel];
+    const double t = core::luminance(throughput);
+    if (pdf <= 0.0f || t <= 1e-8)
+        return;
+    // ring buffer: count is the vertices seen, wrapped so it stays within
+    // 2 * kMaxVertices and still gives the slot of the oldest
+    vertices_[size_t(pixel) * kMaxVertices + count % kMaxVertices] = { leaf, uint32_t(Bin(wi)), float(1.0 / (pdf * t)) };
+    if (++count >= 2 * kMaxVertices)
+        count -= kMaxVertices;
+}
+
+void PathGuide::EndPath(int pixel, const core::Color& L) {
+    uint8_t& count = vertex_count_[pixel];
+    const float radiance = static_cast<float>(std::max(core::luminance(L), 0.0));
+    const Vertex* v = vertices_.data() + size_t(pixel) * kMaxVertices;
+    for (int i = 0; i < std::min<int>(count, kMaxVertices); ++i) {
+        if (radiance > 0.0f)
+            sums_[size_t(v[i].leaf) * kBins + v[i].bin].fetch_add(radiance * v[i].weight, std::memory_order_relaxed);
+        counts_[v[i].leaf].fetch_add(1, std::memory_order_relaxed);
+    }
+    count = 0;
+}
+
+void PathGuide::Refine() {
+    ++iteration_;
+    const size_t leaves = trained_.size();
+
+    // sampling distributions from the radiance seen; leaves nothing reached
+    // keep what they had
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int l = 0; l < int(leaves); ++l) {
+        const std::atomic<float>* sums = sums_.data() + size_t(l) * kBins;
+        double total = 0.0;
+        for (int b = 0; b < kBins; ++b)
+            total += sums[b].load(std::memory_order_relaxed);
+        if (!(total > 0.0))
+            continue;
+
+        float* cdf = cdf_.data() + size_t(l) * kBins;
+        double running = 0.0;
+        for (int b = 0; b < kBins; ++b) {
+            running += sums[b].load(std::memory_order_relaxed);
+            cdf[b] = static_cast<float>(running / total);
+        }
+        cdf[kBins - 1] = 1.0f;
+        trained_[l] = 1;
+    }
+
+    // split busy leaves; new leaves start from their parent's distribution
+    std::vector<uint32_t> counts(leaves);
+    for (size_t l = 0; l < leaves; ++l)
+        counts[l] = counts_[l].load(std::memory_order_relaxed);
+    SplitState state{ kSplitVertices * std::sqrt(std::pow(2.0, iteration_)), counts, {} };
+    Split(0, bounds_, 0, state);
+
+    const size_t grown = leaves + state.sources.size();
+    cdf_.resize(grown * kBins);
+    trained_.resize(grown);
+    for (size_t i = 0; i < state.sources.size(); ++i) {
+        const uint32_t parent = state.sources[i];
+        std::copy_n(cdf_.begin() + size_t(parent) * kBins, kBins, cdf_.begin() + (leaves + i) * kBins);
+        trained_[leaves + i] = trained_[parent];
+    }
+
+    std::vector<std::atomic<float>>(grown * kBins).swap(sums_);
+    std::vector<std::atomic<uint32_t>>(grown).swap(counts_);
+}
+
+void PathGuide::Split(int node, const geom::Aabb& box, int depth, SplitState& state) {
+    const Node n = nodes_[node];
+    if (n.child < 0) {
+        SplitLeaf(node, box, depth, state.counts[n.leaf], state);
+        return;
+    }
+    geom::Aabb lo, hi;
+    Halve(box, n.axis, n.split, lo, hi);
+    Split(n.child, lo, depth + 1, state);
+    Split(n.child + 1, hi, depth + 1, state);
+}
+
+void PathGuide::SplitLeaf(int node, const geom::Aabb& box, int depth, double count, SplitState& state) {
+    // the leaf's vertices are taken as spread evenly over its box, so it is
+    // halved until each part would stay under the threshold
+    const size_t leaves = state.counts.size() + state.sources.size();
+    if (count <= state.threshold || depth >= kMaxDepth || leaves >= kMaxLeaves)
+        return;
+
+    const uint32_t leaf = nodes_[node].leaf;
+    const uint32_t source = leaf < state.counts.size() ? leaf : state.sources[leaf - state.counts.size()];
+    state.sources.push_back(source);
+
+    const int axis = box.LongestAxis();
+    const core::Interval& extent = box.axis_interval(axis);
+    const double split = 0.5 * (extent.min_ + extent.max_);
+
+    Node lo, hi;
+    lo.leaf = leaf;
+    hi.leaf = static_cast<uint32_t>(leaves);
+    const int child = static_cast<int>(nodes_.size());
+    nodes_[node].child = child;
+    nodes_[node].axis = axis;
+    nodes_[node].split = split;
+    nodes_.push_back(lo);
+    nodes_.push_back(hi);
+
+    geom::Aabb lo_box, hi_box;
+    Halve(box, axis, split, lo_box, hi_box);
+    SplitLeaf(child, lo_box, depth + 1, count / 2, state);
+    SplitLeaf(child + 1, hi_box, depth + 1, count / 2, state);
+}
+
+void PathGuide::Halve(const geom::Aabb& box, int axis, double split, geom::Aabb& lo, geom::Aabb& hi) {
+    lo = box;
+    hi = box;
+    (axis == 0 ? lo.x : axis == 1 ? lo.y : lo.z).max_ = split;
+    (axis == 0 ? hi.x : axis == 1 ? hi.y : hi.z).min_ = split;
+}
+
+}  // namespace rt::renderer
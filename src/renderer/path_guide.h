@@ -0,0 +1,112 @@
+#pragma once
+
+#include "core/color.h"
+#include "core/vec3.h"
+#include "geom/aabb.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace rt::renderer {
+
+// Path guiding with a spatial-directional radiance cache, after "Practical
+// Path Guiding" (Mueller et al. 2017).
+//
+// Space is a binary tree over the scene bounds; every leaf holds a
+// histogram of incident radiance over the sphere in an equal-area
+// (cos theta, phi) parameterization. Diffuse vertices draw their next
+// direction from it or from the BSDF, one-sample MIS with the mixture pdf,
+// so the estimate stays unbiased whatever the cache has learned.
+//
+// Learning is iterative. During a sample pass the sampling distributions
+// and the tree are read only; finished paths splat radiance / pdf into a
+// separate set of training bins with relaxed atomic adds, so no thread ever
+// waits on another. Between passes Refine() turns the training bins into
+// the next sampling distributions and splits leaves that received many
+// vertices, the tree growing as the square root of the samples seen.
+class PathGuide {
+public:
+    static constexpr int kRes = 32;                 // directional bins per side
+    static constexpr int kBins = kRes * kRes;
+    static constexpr int kMaxVertices = 4;          // last guided vertices remembered per path
+    static constexpr size_t kMaxLeaves = 4096;
+
+    PathGuide(const geom::Aabb& bounds, size_t pixels);
+
+    PathGuide(const PathGuide&) = delete;
+    PathGuide& operator=(const PathGuide&) = delete;
+
+    // ---- while rendering, from any thread ----
+
+    uint32_t Leaf(const core::Point3& p) const;
+
+    // false until a pass has put radiance into the leaf
+    bool Trained(uint32_t leaf) const { return trained_[leaf] != 0; }
+
+    // unit direction drawn from the leaf's distribution, pdf in solid angle
+    core::Vec3 Sample(uint32_t leaf, double u1, double u2, float& pdf) const;
+    float Pdf(uint32_t leaf, const core::Vec3& dir) const;
+
+    // A pixel has at most one path in flight, so its vertex list needs no
+    // locking. AddVertex remembers a scattering vertex: its incident
+    // radiance is the path's final contribution over the throughput after
+    // the vertex. The last kMaxVertices of a path are kept, a deeper vertex
+    // replacing the oldest. EndPath splats them into the training bins.
+    void BeginWave();
+    void AddVertex(int pixel, uint32_t leaf, const core::Vec3& wi, float pdf, const core::Color& throughput);
+    void EndPath(int pixel, const core::Color& L);
+
+    // ---- between passes ----
+
+    // the training bins become the sampling distributions, busy leaves are
+    // split and the training bins start over
+    void Refine();
+
+    int Iteration() const { return iteration_; }
+    size_t Leaves() const { return trained_.size(); }
+
+private:
+    struct Node {
+        int32_t  child = -1;  // first of two children, -1 for a leaf
+        uint32_t leaf = 0;    // leaf: index of its distributions
+        int      axis = 0;
+        double   split = 0.0;
+    };
+
+    struct Vertex {
+        uint32_t leaf;
+        uint32_t bin;
+        float    weight;  // 1 / (pdf * throughput luminance)
+    };
+
+    struct SplitState {
+        double threshold;
+        const std::vector<uint32_t>& counts;  // vertices per leaf before splitting
+        std::vector<uint32_t> sources;        // per new leaf, the leaf it copies
+    };
+
+    static int Bin(const core::Vec3& dir);
+    static void Halve(const geom::Aabb& box, int axis, double split, geom::Aabb& lo, geom::Aabb& hi);
+    float Probability(uint32_t leaf, int bin) const;
+    void Split(int node, const geom::Aabb& box, int depth, SplitState& state);
+    void SplitLeaf(int node, const geom::Aabb& box, int depth, double count, SplitState& state);
+
+    geom::Aabb bounds_;
+    std::vector<Node> nodes_;
+    int iteration_ = 0;
+
+    // sampling side: per leaf inclusive prefix sums of the bin probabilities
+    std::vector<float>   cdf_;
+    std::vector<uint8_t> trained_;
+
+    // training side
+    std::vector<std::atomic<float>>    sums_;
+    std::vector<std::atomic<uint32_t>> counts_;
+
+    // per pixel vertex lists of the paths in flight
+    std::vector<Vertex>  vertices_;
+    std::vector<uint8_t> vertex_count_;
+};
+
+}  // namespace rt::renderer
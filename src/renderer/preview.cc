@@ -0,0 +1,72 @@
+#include "renderer/preview.h"
+
+#include "scene/image_writer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace rt::renderer {
+
+PreviewWriter::PreviewWriter(std::string path, int width, int height)
+    : path_(std::move(path))
+    , width_(width)
+    , height_(height)
+    , back_(size_t(width) * height, core::Color(0,0,0))
+    , front_(back_.size(), core::Color(0,0,0))
+    , thread_(&PreviewWriter::Loop, this)
+{}
+
+PreviewWriter::~PreviewWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void PreviewWriter::Submit(const std::vector<integrator::PixelState>& pixels, int samples) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < back_.size() && i < pixels.size(); ++i) {
+            back_[i] = pixels[i].samples > 0 ? pixels[i].sum / (float)pixels[i].samples : core::Color(0,0,0);
+        }
+        back_samples_ = samples;
+        fresh_ = true;
+    }
+    wake_.notify_one();
+}
+
+void PreviewWriter::Loop() {
+    while (true) {
+        int samples = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return fresh_ || stop_; });
+            if (!fresh_)
+                return;
+            front_.swap(back_);
+            samples = back_samples_;
+            fresh_ = false;
+        }
+
+        // encoded into a temporary file next to the preview, then renamed
+        const std::string tmp = path_ + ".tmp";
+        scene::ImageFormat format;
+        bool ok = scene::FormatFromPath(path_, format);
+        std::ofstream out;
+        if (ok)
+            out.open(tmp, std::ios::binary);
+        ok = ok && out && scene::WriteImage(out, format, front_, width_, height_);
+        out.close();
+        if (!ok || !out || std::rename(tmp.c_str(), path_.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            std::cerr << "WARNING: Could not write preview '" << path_ << "'\n";
+            continue;
+        }
+        std::clog << "Preview: " << samples << " samples -> " << path_ << "\n";
+    }
+}
+
+}  // namespace rt::renderer
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "core/color.h"
+#include "integrator/pixel_state.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rt::renderer {
+
+// Writes preview images of a render in progress from a background thread.
+//
+// Submit() copies the current per pixel estimate into the back buffer and
+// returns; the writer thread swaps it to the front, encodes it (gamma and
+// clamp for ppm/png, like the final image) and replaces the file through a
+// rename, so viewers never see half an image. If the writer is still busy
+// the back buffer is simply overwritten: only the newest estimate is kept
+// and the render never waits for the disk.
+class PreviewWriter {
+public:
+    PreviewWriter(std::string path, int width, int height);
+    ~PreviewWriter();  // writes the last estimate submitted
+
+    PreviewWriter(const PreviewWriter&) = delete;
+    PreviewWriter& operator=(const PreviewWriter&) = delete;
+
+    void Submit(const std::vector<integrator::PixelState>& pixels, int samples);
+
+private:
+    void Loop();
+
+    std::string path_;
+    int width_;
+    int height_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<core::Color> back_;   // filled by Submit, guarded by mutex_
+    std::vector<core::Color> front_;  // owned by the writer thread
+    int back_samples_ = 0;
+    bool fresh_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+}  // namespace rt::renderer
@@ -0,0 +1,114 @@
+#include "renderer/radiance_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rt::renderer {
+
+namespace {
+
+constexpr int kTableBits = 20;  // 1M cells, 24 MB
+constexpr int kProbes = 16;     // linear probing distance
+
+inline uint64_t Mix(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// one of six bins by the normal's dominant axis and its sign, so opposite
+// sides of a thin wall and the two faces meeting at a corner never share
+inline uint64_t NormalBin(const core::Vec3& n) {
+    const double ax = std::abs(n.x()), ay = std::abs(n.y()), az = std::abs(n.z());
+    if (ax >= ay && ax >= az)
+        return n.x() >= 0 ? 0 : 1;
+    if (ay >= az)
+        return n.y() >= 0 ? 2 : 3;
+    return n.z() >= 0 ? 4 : 5;
+}
+
+}  // namespace
+
+RadianceCache::RadianceCache(const geom::Aabb& bounds, size_t pixels, int bounces)
+    : bounds_(bounds)
+    , bounces_(bounces)
+    , entries_(size_t(1) << kTableBits)
+    , mask_((uint64_t(1) << kTableBits) - 1)
+    , vertices_(pixels * kMaxVertices)
+    , vertex_count_(pixels, 0)
+{
+    const double diagonal = (bounds.max() - bounds.min()).length();
+    inv_cell_size_ = std::isfinite(diagonal) && diagonal > 0 ? kGridResolution / diagonal : 1.0;
+}
+
+uint32_t RadianceCache::Cell(const core::Point3& p, const core::Vec3& normal) {
+    const core::Vec3 q = (p - bounds_.min()) * inv_cell_size_;
+    const uint64_t ix = uint64_t(int64_t(std::floor(q.x()))) & 0xFFFFF;
+    const uint64_t iy = uint64_t(int64_t(std::floor(q.y()))) & 0xFFFFF;
+    const uint64_t iz = uint64_t(int64_t(std::floor(q.z()))) & 0xFFFFF;
+    const uint64_t packed = ix | (iy << 20) | (iz << 40) | (NormalBin(normal) << 60);
+    const uint64_t key = packed + 1;
+
+    uint64_t slot = Mix(packed) & mask_;
+    for (int i = 0; i < kProbes; ++i, slot = (slot + 1) & mask_) {
+        uint64_t current = entries_[slot].key.load(std::memory_order_relaxed);
+        if (current == 0 && entries_[slot].key.compare_exchange_strong(current, key, std::memory_order_relaxed))
+            return static_cast<uint32_t>(slot);
+        if (current == key)
+            return static_cast<uint32_t>(slot);
+    }
+    return kNoCell;
+}
+
+bool RadianceCache::Lookup(uint32_t cell, core::Color& irradiance) const {
+    if (cell == kNoCell)
+        return false;
+    const Entry& e = entries_[cell];
+    const uint32_t count = e.count.load(std::memory_order_relaxed);
+    if (count < kMinSamples)
+        return false;
+    irradiance = core::Color(e.r.load(std::memory_order_relaxed),
+                             e.g.load(std::memory_order_relaxed),
+                             e.b.load(std::memory_order_relaxed)) / double(count);
+    return true;
+}
+
+void RadianceCache::BeginWave() {
+    std::fill(vertex_count_.begin(), vertex_count_.end(), 0);
+}
+
+void RadianceCache::AddVertex(int pixel, uint32_t cell, const core::Color& throughput_bsdf) {
+    uint8_t& count = vertex_count_[pixel];
+    if (count >= kMaxVertices || cell == kNoCell)
+        return;
+    Vertex& v = vertices_[size_t(pixel) * kMaxVertices + count++];
+    v.cell = cell;
+    for (int c = 0; c < 3; ++c)
+        v.weight[c] = throughput_bsdf[c] > 1e-8 ? float(1.0 / throughput_bsdf[c]) : 0.0f;
+}
+
+void RadianceCache::EndPath(int pixel, const core::Color& L) {
+    uint8_t& count = vertex_count_[pixel];
+    const Vertex* v = vertices_.data() + size_t(pixel) * kMaxVertices;
+    for (int i = 0; i < count; ++i) {
+        Entry& e = entries_[v[i].cell];
+        e.r.fetch_add(float(L.x()) * v[i].weight[0], std::memory_order_relaxed);
+        e.g.fetch_add(float(L.y()) * v[i].weight[1], std::memory_order_relaxed);
+        e.b.fetch_add(float(L.z()) * v[i].weight[2], std::memory_order_relaxed);
+        e.count.fetch_add(1, std::memory_order_relaxed);
+    }
+    count = 0;
+}
+
+size_t RadianceCache::CellsUsed() const {
+    size_t used = 0;
+    for (const Entry& e : entries_)
+        used += e.key.load(std::memory_order_relaxed) != 0;
+    return used;
+}
+
+}  // namespace rt::renderer
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core/color.h"
+#include "core/vec3.h"
+#include "geom/aabb.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace rt::renderer {
+
+// Radiance cache for diffuse interreflection: a hashed grid over the scene
+// keyed by position and normal, learning the irradiance arriving at diffuse
+// surfaces from the frame's own paths.
+//
+// It stores irradiance rather than outgoing radiance, so a lookup is turned
+// back into radiance with the surface's own BSDF (material::EvalLambertian,
+// what Material::Eval and MaterialTable::Eval return for diffuse surfaces)
+// and textures keep their full resolution while the cache cells are coarse.
+//
+// Paths whose diffuse vertex is `bounces` or more bounces deep end there
+// with the cached value once its cell has enough samples. This cuts the
+// long diffuse-diffuse chains for a bias bounded by the cell size, which
+// suits previews. Cells are filled with relaxed atomic adds and claimed by
+// compare-and-swap, so threads never block each other; a lookup may see a
+// cell half way through an update, which only adds noise.
+class RadianceCache {
+public:
+    static constexpr uint32_t kNoCell = UINT32_MAX;
+    static constexpr int kGridResolution = 128;  // cells along the scene's diagonal
+    static constexpr int kMaxVertices = 4;       // vertices remembered per path
+    static constexpr uint32_t kMinSamples = 16;  // before a cell is used
+
+    RadianceCache(const geom::Aabb& bounds, size_t pixels, int bounces);
+
+    RadianceCache(const RadianceCache&) = delete;
+    RadianceCache& operator=(const RadianceCache&) = delete;
+
+    int Bounces() const { return bounces_; }
+
+    // the cell of a surface point, claimed on first use; kNoCell when the
+    // table is full around it
+    uint32_t Cell(const core::Point3& p, const core::Vec3& normal);
+
+    // false until the cell has kMinSamples
+    bool Lookup(uint32_t cell, core::Color& irradiance) const;
+
+    // A pixel has at most one path in flight, so its vertex list needs no
+    // locking. AddVertex remembers a diffuse vertex with the throughput
+    // reaching it times its BSDF value; EndPath divides the path's final
+    // contribution by that and adds it to the vertex's cell.
+    void BeginWave();
+    void AddVertex(int pixel, uint32_t cell, const core::Color& throughput_bsdf);
+    void EndPath(int pixel, const core::Color& L);
+
+    size_t CellsUsed() const;
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> key{0};  // packed cell coordinates + 1, 0 when free
+        std::atomic<float> r{0.0f}, g{0.0f}, b{0.0f};
+        std::atomic<uint32_t> count{0};
+    };
+
+    struct Vertex {
+        uint32_t cell;
+        float    weight[3];  // 1 / (throughput x BSDF) per channel
+    };
+
+    geom::Aabb bounds_;
+    double inv_cell_size_;
+    int bounces_;
+
+    std::vector<Entry> entries_;
+    uint64_t mask_;
+
+    std::vector<Vertex>  vertices_;
+    std::vector<uint8_t> vertex_count_;
+};
+
+}  // namespace rt::renderer
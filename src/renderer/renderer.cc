@@ -0,0 +1,88 @@
+#include "renderer/renderer.h"
+
+#include "core/timer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace rt::renderer {
+
+namespace {
+
+// calibration work: kTiles tiles of kTileSize^2 pixels, kSamples samples
+// each, about 2% of a 300x200 image at 32 samples per pixel per candidate.
+// The first tile is not timed, it allocates the image buffers.
+// Tiles are as large as the distributed renderer's, so the wavefront works
+// on queues of the size it sees there.
+constexpr int kTiles = 5;
+constexpr int kTileSize = 64;
+constexpr int kSamples = 2;
+
+}  // namespace
+
+bool ParseStrategy(const std::string& name, Strategy& strategy) {
+    if (name == "wavefront")
+        strategy = Strategy::kWavefront;
+    else if (name == "mega-kernel")
+        strategy = Strategy::kMegaKernel;
+    else if (name == "auto")
+        strategy = Strategy::kAuto;
+    else {
+        std::cerr << "ERROR: Unknown renderer '" << name << "'\n";
+        return false;
+    }
+    return true;
+}
+
+size_t Calibrate(const std::vector<Renderer*>& candidates, int width, int height) {
+    std::vector<double> seconds(candidates.size(), 0.0);
+    std::vector<uint64_t> rays(candidates.size(), 0);
+
+    // tiles in distinct rows and columns of a kTiles x kTiles grid, so they
+    // spread over both axes
+    const int tile_w = std::min(kTileSize, width);
+    const int tile_h = std::min(kTileSize, height);
+    for (int t = 0; t < kTiles; ++t) {
+        const int cx = (2 * t + 1) * width / (2 * kTiles);
+        const int cy = (2 * ((t * 3) % kTiles) + 1) * height / (2 * kTiles);
+        const int x0 = std::clamp(cx - tile_w / 2, 0, width - tile_w);
+        const int y0 = std::clamp(cy - tile_h / 2, 0, height - tile_h);
+
+        // candidates take turns per tile, so both see the same cache state
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            Renderer& r = *candidates[c];
+            r.SetRegion(x0, y0, x0 + tile_w, y0 + tile_h);
+            r.SetSampleRange(0, kSamples);
+            core::Timer clock;
+            r.Render();
+            if (t > 0) {
+                seconds[c] += clock.elapsed();
+                rays[c] += r.RaysTraced();
+            }
+        }
+    }
+
+    size_t best = 0;
+    std::vector<double> rate(candidates.size());
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        candidates[c]->SetRegion(0, 0, -1, -1);
+        candidates[c]->SetSampleRange(0, -1);
+        rate[c] = seconds[c] > 0.0 ? rays[c] / seconds[c] : 0.0;
+        if (rate[c] > rate[best])
+            best = c;
+    }
+
+    std::clog << "Calibration:";
+    for (size_t c = 0; c < candidates.size(); ++c)
+        std::clog << " " << candidates[c]->Name() << " " << std::setprecision(3) << rate[c] * 1e-6 << " Mrays/s";
+    std::clog << " -> " << candidates[best]->Name() << "\n";
+
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        if (c != best)
+            candidates[c]->ReleaseBuffers();
+    }
+    return best;
+}
+
+} // namespace rt::renderer
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/color.h"
+#include "integrator/pixel_state.h"
+
+namespace rt::renderer {
+
+// A strategy for rendering a camera's image. The wavefront renderer
+// (renderer/wavefront.h) shades one bounce of many rays at a time, the
+// mega-kernel (renderer/mega_kernel.h) traces whole paths per thread. Both
+// run the same path integrator and produce the same image, so which one is
+// used only changes the speed.
+class Renderer {
+public:
+    virtual ~Renderer() = default;
+
+    virtual const char* Name() const = 0;
+
+    // Restricts the next Render() to pixels [x0, x1) x [y0, y1) and sample
+    // indices [begin, end). Negative ends mean "to the edge / max samples".
+    virtual void SetRegion(int x0, int y0, int x1, int y1) = 0;
+    virtual void SetSampleRange(int begin, int end) = 0;
+
+    virtual void Render() = 0;
+
+    // Once *stop is set (e.g. from a signal handler) Render() finishes early
+    // with an image of everything traced so far, see the implementations.
+    virtual void SetStopFlag(const std::atomic<bool>* stop) = 0;
+
+    // ray segments intersected by the last Render()
+    virtual uint64_t RaysTraced() const = 0;
+
+    // per pixel statistics of the last render, row-major
+    virtual const std::vector<integrator::PixelState>& Pixels() const = 0;
+
+    // linear radiance of the last render, row-major
+    virtual const std::vector<core::Color>& Framebuffer() const = 0;
+
+    // frees the per pixel buffers until the next Render()
+    virtual void ReleaseBuffers() = 0;
+};
+
+enum class Strategy {
+    kWavefront,
+    kMegaKernel,
+    kAuto,  // calibrated per scene and resolution, see Calibrate
+};
+
+// "wavefront", "mega-kernel" or "auto"
+bool ParseStrategy(const std::string& name, Strategy& strategy);
+
+// Auto mode: renders the same few tiles, a few samples each, with every
+// candidate in turn and returns the index of the one that traced the most
+// rays per second. The candidates' region and sample range are reset to the
+// whole image afterwards, and the others' buffers are released.
+size_t Calibrate(const std::vector<Renderer*>& candidates, int width, int height);
+
+} // namespace rt::renderer
@@ -0,0 +1,272 @@
+#include "renderer/shading.h"
+
+#include "core/math_utils.h"
+#include "geom/hittable.h"
+#include "integrator/path_integrator.h"
+#include "material/bsdf.h"
+#include "material/material_table.h"
+#include "renderer/path_guide.h"
+#include "renderer/radiance_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+namespace rt::renderer {
+
+namespace {
+
+// buckets are the material types plus one for misses / depth limit
+constexpr int kMissBucket   = 4;
+constexpr int kBucketCount  = 5;
+
+// lambertian rays are sampled this many at a time
+constexpr int kLanes = 8;
+
+// path guiding: share of diffuse bounces drawn from the guide where it has
+// learned something, the rest sample the cosine lobe
+constexpr double kGuideFraction = 0.5;
+
+// records a finished path and runs the adaptive convergence test
+inline void FinishPath(const ShadeContext& ctx, int pixel, const core::Color& L) {
+    integrator::PixelState& ps = ctx.pixels[pixel];
+    if (ctx.guide)
+        ctx.guide->EndPath(pixel, L);
+    if (ctx.cache)
+        ctx.cache->EndPath(pixel, L);
+    integrator::RecordSample(ps, L);
+    if (!ps.converged &&
+        integrator::IsConverged(ps, ctx.rel_threshold, ctx.min_samples))
+        ps.converged = true;
+}
+
+// russian roulette, then queue the scattered ray; false if the path ended
+// rng is the stream of the vertex that scattered
+inline bool QueueChild(
+    const ShadeContext& ctx,
+    integrator::RayState& child,
+    core::CounterRng& rng,
+    std::vector<integrator::RayState>& out
+) {
+    if (!integrator::RussianRoulette(child, rng)) {
+        FinishPath(ctx, child.pixel_index, core::Color(0,0,0));
+        return false;
+    }
+
+    out.push_back(child);
+    return true;
+}
+
+// ---------------- Kernels ----------------
+// Each kernel is an orphaned omp worksharing loop, called from inside the
+// parallel region in ShadeBatch.
+
+void ShadeMisses(
+    const ShadeContext& ctx,
+    const integrator::RayState* rays,
+    const std::vector<uint32_t>& bucket
+) {
+    #pragma omp for schedule(dynamic, 64) nowait
+    for (size_t k = 0; k < bucket.size(); ++k) {
+        const auto& rs = rays[bucket[k]];
+        FinishPath(ctx, rs.pixel_index, rs.throughput * integrator::Background(rs.r));
+    }
+}
+
+void ShadeLights(
+    const ShadeContext& ctx,
+    const integrator::RayState* rays,
+    const geom::HitRecord* hits,
+    const std::vector<uint32_t>& bucket
+) {
+    #pragma omp for schedule(dynamic, 64) nowait
+    for (size_t k = 0; k < bucket.size(); ++k) {
+        const auto& rs  = rays[bucket[k]];
+        const auto& rec = hits[bucket[k]];
+
+        FinishPath(ctx, rs.pixel_index, integrator::LightHit(ctx.materials, rs, rec));
+    }
+}
+
+// cosine sampling for kLanes rays at once, then per lane bookkeeping.
+// With a path guide, lanes whose cache cell has learned something pick the
+// guide or the cosine lobe with the first random number (rescaled, so each
+// technique still sees a uniform number) and weight by the mixture pdf.
+// With a radiance cache, deep vertices whose cell is ready end the path with
+// the cached irradiance through the BSDF; the others train their cell.
+void ShadeLambertian(
+    const ShadeContext& ctx,
+    const integrator::RayState* rays,
+    const geom::HitRecord* hits,
+    const std::vector<uint32_t>& bucket,
+    std::vector<integrator::RayState>& out
+) {
+    const int num_groups = static_cast<int>((bucket.size() + kLanes - 1) / kLanes);
+
+    #pragma omp for schedule(dynamic, 16) nowait
+    for (int g = 0; g < num_groups; ++g) {
+        const size_t base = size_t(g) * kLanes;
+        const int n = static_cast<int>(std::min<size_t>(kLanes, bucket.size() - base));
+
+        core::CounterRng rng[kLanes];
+        alignas(64) double u1[kLanes], u2[kLanes];
+        uint32_t leaf[kLanes];
+        bool guided[kLanes] = {};  // lane draws from the guide
+        double ug[kLanes];         // its rescaled first number
+        alignas(64) double nx[kLanes], ny[kLanes], nz[kLanes];
+        alignas(64) double wx[kLanes], wy[kLanes], wz[kLanes];
+
+        // gather samples and normals
+        for (int l = 0; l < n; ++l) {
+            const auto& rs  = rays[bucket[base + l]];
+            const auto& rec = hits[bucket[base + l]];
+
+            rng[l] = core::CounterRng(rs.pixel_index, rs.sample, rs.depth + 1, ctx.sample_mode);
+            const core::Sample2D xi = rng[l].Next2D();
+            u1[l] = xi.u;
+            u2[l] = xi.v;
+
+            if (ctx.guide) {
+                leaf[l] = ctx.guide->Leaf(rec.p);
+                if (ctx.guide->Trained(leaf[l])) {
+                    guided[l] = u1[l] < kGuideFraction;
+                    if (guided[l])
+                        ug[l] = u1[l] / kGuideFraction;
+                    else
+                        u1[l] = (u1[l] - kGuideFraction) / (1.0 - kGuideFraction);
+                }
+            }
+
+            const core::Vec3 w = core::Normalize(rec.normal);
+            nx[l] = w.x();
+            ny[l] = w.y();
+            nz[l] = w.z();
+        }
+
+        core::SampleCosineDirectionBatch(u1, u2, nx, ny, nz, wx, wy, wz, n);
+
+        for (int l = 0; l < n; ++l) {
+            const auto& rs  = rays[bucket[base + l]];
+            const auto& rec = hits[bucket[base + l]];
+            auto& ps = ctx.pixels[rs.pixel_index];
+
+            const integrator::Footprint fp = integrator::ConeFootprint(rs, rec);
+            const core::Color albedo = integrator::DiffuseAlbedo(ctx.materials, rec, fp);
+
+            if (ctx.cache) {
+                const uint32_t cell = ctx.cache->Cell(rec.p, rec.normal);
+                const core::Color f_n = material::EvalLambertian(albedo, rec, rec.normal);
+                core::Color irradiance;
+                if (rs.depth >= ctx.cache->Bounces() && ctx.cache->Lookup(cell, irradiance)) {
+                    FinishPath(ctx, rs.pixel_index, rs.throughput * f_n * irradiance);
+                    continue;
+                }
+                ctx.cache->AddVertex(rs.pixel_index, cell, rs.throughput * f_n);
+            }
+
+            float guide_pdf = 0.0f;
+            core::Vec3 wi(wx[l], wy[l], wz[l]);
+            if (guided[l])
+                wi = ctx.guide->Sample(leaf[l], ug[l], u2[l], guide_pdf);
+            if (core::Dot(wi, rec.normal) <= 0) {
+                FinishPath(ctx, rs.pixel_index, core::Color(0,0,0));
+                continue;
+            }
+
+            float pdf = material::PdfLambertian(rec, wi);
+
+            // one-sample MIS: either technique could have drawn wi
+            const bool mixed = ctx.guide && ctx.guide->Trained(leaf[l]);
+            if (mixed) {
+                if (!guided[l])
+                    guide_pdf = ctx.guide->Pdf(leaf[l], wi);
+                pdf = float(kGuideFraction * guide_pdf + (1.0 - kGuideFraction) * pdf);
+            }
+
+            if (ps.converged)
+                continue;
+
+            integrator::RayState child;
+            if (!integrator::DiffuseChild(rs, rec, albedo, wi, pdf, fp.width, child)) {
+                FinishPath(ctx, rs.pixel_index, core::Color(0,0,0));
+                continue;
+            }
+            if (QueueChild(ctx, child, rng[l], out) && ctx.guide)
+                ctx.guide->AddVertex(rs.pixel_index, leaf[l], wi, pdf, child.throughput);
+        }
+    }
+}
+
+// delta lobes, sampled by the shared vertex function
+template <material::MaterialType kType>
+void ShadeSpecular(
+    const ShadeContext& ctx,
+    const integrator::RayState* rays,
+    const geom::HitRecord* hits,
+    const std::vector<uint32_t>& bucket,
+    std::vector<integrator::RayState>& out
+) {
+    #pragma omp for schedule(dynamic, 64) nowait
+    for (size_t k = 0; k < bucket.size(); ++k) {
+        const auto& rs  = rays[bucket[k]];
+        const auto& rec = hits[bucket[k]];
+        auto& ps = ctx.pixels[rs.pixel_index];
+
+        core::CounterRng rng(rs.pixel_index, rs.sample, rs.depth + 1, ctx.sample_mode);
+        integrator::RayState child;
+        if (!integrator::SpecularChild<kType>(ctx.materials, rs, rec, rng, child)) {
+            FinishPath(ctx, rs.pixel_index, core::Color(0,0,0));
+            continue;
+        }
+
+        if (ps.converged)
+            continue;
+
+        QueueChild(ctx, child, rng, out);
+    }
+}
+
+} // namespace
+
+void ShadeBatch(
+    const ShadeContext& ctx,
+    const integrator::RayState* rays,
+    const geom::HitRecord* hits,
+    size_t count,
+    std::vector<integrator::RayState>& next_queue
+) {
+    // Bucket by material type
+    std::vector<uint32_t> buckets[kBucketCount];
+    for (size_t i = 0; i < count; ++i) {
+        int b = kMissBucket;
+        if (hits[i].hit && rays[i].depth < ctx.max_depth)
+            b = static_cast<int>(ctx.materials[hits[i].mat_id].type);
+        buckets[b].push_back(static_cast<uint32_t>(i));
+    }
+
+    using material::MaterialType;
+    const int thread_count = omp_get_max_threads();
+    std::vector<std::vector<integrator::RayState>> local_queues(thread_count);
+
+    #pragma omp parallel
+    {
+        auto& out = local_queues[omp_get_thread_num()];
+
+        ShadeMisses(ctx, rays, buckets[kMissBucket]);
+        ShadeLights(ctx, rays, hits, buckets[int(MaterialType::kDiffuseLight)]);
+        ShadeLambertian(ctx, rays, hits, buckets[int(MaterialType::kLambertian)], out);
+        ShadeSpecular<MaterialType::kMetal>(ctx, rays, hits, buckets[int(MaterialType::kMetal)], out);
+        ShadeSpecular<MaterialType::kDielectric>(ctx, rays, hits, buckets[int(MaterialType::kDielectric)], out);
+    }
+
+    // Merge queues
+    for (int t = 0; t < thread_count; t++) {
+        next_queue.insert(
+            next_queue.end(),
+            local_queues[t].begin(),
+            local_queues[t].end()
+        );
+    }
+}
+
+} // namespace rt::renderer
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "core/color.h"
+#include "core/random.h"
+#include "core/ray.h"
+#include "integrator/pixel_state.h"
+#include "integrator/ray_state.h"
+
+namespace rt::geom {
+class HitRecord;
+}
+
+namespace rt::material {
+class MaterialTable;
+}
+
+namespace rt::renderer {
+
+class PathGuide;
+class RadianceCache;
+
+// everything the shading kernels need for one batch
+struct ShadeContext {
+    const material::MaterialTable&        materials;
+    std::vector<integrator::PixelState>&  pixels;
+    core::SampleMode sample_mode;
+    int   max_depth;
+    float rel_threshold;  // adaptive convergence test
+    int   min_samples;
+    PathGuide* guide = nullptr;  // guides diffuse bounces and learns from the paths
+    RadianceCache* cache = nullptr;  // ends deep diffuse paths and learns from the paths
+};
+
+// Shades one intersected batch, one bounce of the shared path integrator
+// (integrator/path_integrator.h) for every ray.
+// Rays are bucketed by material type (plus misses) and every bucket runs its
+// own kernel, so there is no per-ray virtual dispatch and lambertian rays are
+// sampled in SIMD groups. Random numbers are keyed per path vertex, so the
+// image does not depend on bucket or thread order.
+// Surviving paths are appended to next_queue.
+void ShadeBatch(
+    const ShadeContext& ctx,
+    const integrator::RayState* rays,
+    const geom::HitRecord* hits,
+    size_t count,
+    std::vector<integrator::RayState>& next_queue
+);
+
+} // namespace rt::renderer
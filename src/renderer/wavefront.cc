@@ -1,17 +1,105 @@
 #include "renderer/wavefront.h"
+#include "renderer/checkpoint.h"
+#include "renderer/path_guide.h"
+#include "renderer/radiance_cache.h"
+#include "renderer/preview.h"
+#include "renderer/shading.h"
 
 #include "material/material.h"
 #include "math_utils.h"
 #include "scene/scene.h"
 #include "scene/camera.h"
 #include "geom/hittable.h"
+#include "integrator/path_integrator.h"
 #include "integrator/ray_integrator.h"
+#include "core/timer.h"
 #include <omp.h>
 
+#include <limits>
+#include <memory>
+
 using namespace rt;
 
 namespace rt::renderer {
 
+namespace {
+
+// Splits as many samples as the region has open (unconverged) pixels, the
+// cost of a uniform pass, over those pixels in proportion to
+// their 8x8 tile's error. A pixel's weight is the relative standard deviation
+// of one luminance sample (LuminanceError * sqrt(n)), so over many passes
+// tiles get samples in proportion to sigma / mu, the allocation minimizing
+// the summed relative variance. Within a tile the samples are dealt round
+// robin, rotating with the pass. Returns the largest quota.
+int ScheduleSamples(const std::vector<integrator::PixelState>& pixels, int width,
+                    int x0, int y0, int x1, int y1, int tile, int pass,
+                    int max_quota, std::vector<uint8_t>& quota) {
+    struct TileWeight { int x, y, open; double weight; };
+    std::vector<TileWeight> tiles;
+    double total = 0.0;
+    int budget = 0;
+    for (int ty = y0; ty < y1; ty += tile) {
+        for (int tx = x0; tx < x1; tx += tile) {
+            TileWeight t{ tx, ty, 0, 0.0 };
+            for (int y = ty; y < std::min(ty + tile, y1); ++y) {
+                for (int x = tx; x < std::min(tx + tile, x1); ++x) {
+                    const integrator::PixelState& ps = pixels[y * width + x];
+                    if (ps.converged)
+                        continue;
+                    ++t.open;
+                    t.weight += integrator::LuminanceError(ps) * std::sqrt(double(ps.samples));
+                }
+            }
+            total += t.weight;
+            budget += t.open;
+            tiles.push_back(t);
+        }
+    }
+
+    std::fill(quota.begin(), quota.end(), 0);
+    if (total <= 0.0)
+        return 0;
+
+    int largest = 0;
+    double carry = 0.0;  // rounding left over, passed on to the next tile
+    for (const TileWeight& t : tiles) {
+        if (t.open == 0)
+            continue;
+        const double share = budget * t.weight / total + carry;
+        const int n = std::min(int(share), t.open * max_quota);
+        carry = share - n;
+
+        const int q = n / t.open;
+        const int r = n % t.open;
+        int j = 0;
+        for (int y = t.y; y < std::min(t.y + tile, y1); ++y) {
+            for (int x = t.x; x < std::min(t.x + tile, x1); ++x) {
+                if (pixels[y * width + x].converged)
+                    continue;
+                const int k = q + ((j + pass) % t.open < r ? 1 : 0);
+                quota[y * width + x] = uint8_t(k);
+                largest = std::max(largest, k);
+                ++j;
+            }
+        }
+    }
+    return largest;
+}
+
+}  // namespace
+
+bool ParseSchedule(const std::string& name, Schedule& schedule) {
+    if (name == "uniform")
+        schedule = Schedule::kUniform;
+    else if (name == "variance")
+        schedule = Schedule::kVariance;
+    else {
+        std::cerr << "ERROR: Unknown schedule '" << name << "'\n";
+        return false;
+    }
+    return true;
+}
+
 // constructor
 WavefrontRenderer::WavefrontRenderer(
     const scene::Scene& world,
@@ -29,216 +117,349 @@ WavefrontRenderer::WavefrontRenderer(
     , batch_size(batch_size)
 {}
 
-// background helper
-core::Color WavefrontRenderer::background(const core::Ray& r) {
-    core::Vec3 unit_direction = core::Normalize(r.direction());
-    auto t = 0.5 * (unit_direction.y() + 1.0);
-    return (1.0 - t) * core::Color(1.0, 1.0, 1.0)
-         + t         * core::Color(0.5, 0.7, 1.0);
+bool WavefrontRenderer::Resume(const std::string& path) {
+    Checkpoint checkpoint;
+    if (!ReadCheckpoint(path, checkpoint))
+        return false;
+    if (checkpoint.key != checkpoint_key || checkpoint.width != cam.get_image_width() ||
+        checkpoint.height != cam.get_image_height() || checkpoint.sample_mode != cam.sample_mode_) {
+        std::cerr << "ERROR: Checkpoint '" << path << "' was written for a different scene or camera\n";
+        return false;
+    }
+
+    pixels = std::move(checkpoint.pixels);
+    framebuffer.assign(pixels.size(), core::Color(0,0,0));
+    resume_sample = checkpoint.next_sample;
+    std::clog << "Resuming at sample " << resume_sample << " from " << path << "\n";
+    return true;
+}
+
+void WavefrontRenderer::ReleaseBuffers() {
+    std::vector<integrator::PixelState>().swap(pixels);
+    std::vector<core::Color>().swap(framebuffer);
+    guides = GBuffer();
 }
 
 void WavefrontRenderer::Render() {
 
     const float kRelThresh  = 0.05;  // Adaptive threshold
     const int   kMinSamples = 16;
+    const int   kFocusTile  = 8;     // time budget: tiles sampled together
+    const float kFocusCutoff = 0.5;  // time budget: skip tiles below this x mean error
+    const int   kMaxPassSamples = 16; // variance schedule: most samples of a pixel per pass
+    const int   kBudgetCapFactor = 16; // budgets: default sample cap, times max samples
+
+    const material::MaterialTable& materials = world.Materials();
 
     const int width  = cam.get_image_width();
     const int height = cam.get_image_height();
     const int npix   = width * height;
 
-    std::vector<integrator::PixelState> pixels(npix);
-    std::vector<core::Color> framebuffer(npix);
+    const int x0 = std::clamp(region[0], 0, width);
+    const int y0 = std::clamp(region[1], 0, height);
+    const int x1 = region[2] < 0 ? width : std::clamp(region[2], x0, width);
+    const int y1 = region[3] < 0 ? height : std::clamp(region[3], y0, height);
+    int s0 = std::max(sample_begin, 0);
+    const bool budgeted = time_budget > 0 || noise_target > 0;
+    // a noise target that is never met (fireflies, pixels that stay black)
+    // still ends at the budget's sample cap
+    const int budget_cap = budget_max_samples > 0 ? budget_max_samples
+        : (int)std::min<long>((long)kBudgetCapFactor * max_ssp, std::numeric_limits<int>::max());
+    const int s_cap = budgeted ? std::max(budget_cap, s0) : max_ssp;
+    const int s1 = sample_end < 0 ? s_cap : std::min(sample_end, s_cap);
+
+    // buffers are kept between renders of the same size, so rendering
+    // many small tiles does not clear the whole image each time
+    if (resume_sample >= 0) {
+        // a resumed render keeps the loaded statistics
+        s0 = std::max(s0, resume_sample);
+        resume_sample = -1;
+    } else {
+        if ((int)pixels.size() != npix) {
+            pixels.assign(npix, integrator::PixelState{});
+            framebuffer.assign(npix, core::Color(0,0,0));
+        }
+        for (int y = y0; y < y1; ++y)
+            std::fill(pixels.begin() + y * width + x0, pixels.begin() + y * width + x1, integrator::PixelState{});
+    }
+
+    // guides are not checkpointed, after a resume they average the new samples
+    if (collect_guides) {
+        if ((int)guides.count.size() != npix) {
+            guides.Resize(npix);
+        } else {
+            for (int y = y0; y < y1; ++y)
+                for (int x = x0; x < x1; ++x)
+                    guides.Clear(y * width + x);
+        }
+    }
+
+    // snapshots are copied between passes and written by another thread
+    CheckpointWriter checkpoints;
+    core::Timer checkpoint_clock;
+    auto checkpoint = [&](int next_sample) {
+        Checkpoint c{ width, height, cam.sample_mode_, checkpoint_key, next_sample, pixels };
+        return checkpoints.Submit(checkpoint_path, std::move(c));
+    };
+
+    // under a time budget the pass selection decides where samples go, and
+    // a noise target needs no pixel to go below it
+    float rel_threshold = kRelThresh;
+    if (time_budget > 0)
+        rel_threshold = 0.0f;
+    if (noise_target > 0)
+        rel_threshold = static_cast<float>(noise_target);
+
+    // the guide learns from this frame's paths, starting empty; it is
+    // refined after passes 1, 2, 4, 8, ... so every iteration trains on
+    // twice the samples of the last
+    std::unique_ptr<PathGuide> guide;
+    if (guiding)
+        guide = std::make_unique<PathGuide>(world.BoundingBox(), npix);
+    int next_refine = s0 + 1;
+
+    // the radiance cache also starts empty and keeps learning all frame
+    std::unique_ptr<RadianceCache> cache;
+    if (cache_bounces > 0)
+        cache = std::make_unique<RadianceCache>(world.BoundingBox(), npix, cache_bounces);
+
+    const ShadeContext ctx{ materials, pixels, cam.sample_mode_, max_depth, rel_threshold, kMinSamples,
+                            guide.get(), cache.get() };
+
+    // time budget: pixels whose error is below the cutoff sit out the pass
+    std::vector<float> error;
+    float cutoff = 0.0f;
+
+    // variance schedule: samples every pixel takes in the next pass, traced
+    // in waves of at most one path per pixel (a pixel's state is updated
+    // without locks), empty while passes are uniform
+    const bool scheduled = schedule == Schedule::kVariance;
+    std::vector<uint8_t> quota;
+    int waves = 1;
+    core::Timer render_clock;
+    double pass_seconds = 0.0;
+    time_to_threshold = -1.0;
+    rays_traced = 0;
+
+    std::unique_ptr<PreviewWriter> preview;
+    core::Timer preview_clock;
+    int previewed = -1;
+    if (!preview_path.empty())
+        preview = std::make_unique<PreviewWriter>(preview_path, width, height);
 
     std::vector<integrator::RayState> ray_queue;
     std::vector<integrator::RayState> next_ray_queue;
     ray_queue.reserve(batch_size);
     next_ray_queue.reserve(batch_size);
 
-    for (int s = 0; s < max_ssp; ++s) {
-
-        ray_queue.clear();
+    int s_done = s0;
+    for (int s = s0; s < s1; ++s) {
 
-        // Generate primary rays for non-converged pixels
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
+        // a pass that would overrun the budget is not started
+        if (time_budget > 0 && s > s0 && render_clock.elapsed() + pass_seconds > time_budget)
+            break;
+        core::Timer pass_clock;
 
-                int idx = y * width + x;
-                auto& ps = pixels[idx];
+        size_t traced = 0;
+        for (int wave = 0; wave < waves; ++wave) {
 
-                if (ps.converged)
-                    continue;
+            ray_queue.clear();
+            if (guide)
+                guide->BeginWave();
+            if (cache)
+                cache->BeginWave();
 
-                integrator::RayState rs;
-                rs.r           = cam.GetRay(x, y);
-                rs.pixel_index = idx;
-                rs.depth       = 0;
-                rs.throughput  = core::Color(1,1,1);
+            // Generate primary rays for non-converged pixels
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
 
-                ray_queue.push_back(rs);
-            }
-        }
+                    int idx = y * width + x;
+                    auto& ps = pixels[idx];
 
-        std::clog << "Sample " << s
-            << "    queue=" << ray_queue.size() << "\n";
+                    if (ps.converged || (!error.empty() && error[idx] < cutoff))
+                        continue;
+                    if (!quota.empty() && quota[idx] <= wave)
+                        continue;
 
-        // Process queue
-        while (!ray_queue.empty()) {
+                    // pixels that sit out passes (or take several samples in
+                    // one) use their own sample count as the index, so each
+                    // still walks an unbroken Sobol prefix
+                    const int sample = time_budget > 0 || scheduled ? ps.samples : s;
 
-            size_t offset = 0;
+                    ray_queue.push_back(integrator::CameraRay(cam, x, y, idx, sample));
+                }
+            }
 
-            while (offset < ray_queue.size()) {
+            traced += ray_queue.size();
 
-                size_t count = std::min(
-                    (size_t)batch_size,
-                    ray_queue.size() - offset
-                );
+            // Process queue
+            while (!ray_queue.empty()) {
 
-                // Build batch
-                std::vector<core::Ray> batch_rays(count);
-                for (size_t i = 0; i < count; ++i)
-                    batch_rays[i] = ray_queue[offset + i].r;
+                size_t offset = 0;
 
-                // Intersect
-                std::vector<geom::HitRecord> hits;
-                integrator.IntersectBatch(batch_rays, hits);
+                while (offset < ray_queue.size()) {
 
-                int thread_count = omp_get_max_threads();
-                std::vector<std::vector<integrator::RayState>>
-                local_queues(thread_count);
+                    size_t count = std::min(
+                        (size_t)batch_size,
+                        ray_queue.size() - offset
+                    );
 
-                #pragma omp parallel for schedule(dynamic)
-                for (int i = 0; i < (int)count; i++) {
+                    // Build batch
+                    std::vector<core::Ray> batch_rays(count);
+                    for (size_t i = 0; i < count; ++i)
+                        batch_rays[i] = ray_queue[offset + i].r;
+
+                    // Intersect
+                    std::vector<geom::HitRecord> hits;
+                    integrator.IntersectBatch(batch_rays, hits);
+                    rays_traced += count;
+
+                    // first hits feed the guide buffers
+                    if (collect_guides) {
+                        const integrator::RayState* batch = ray_queue.data() + offset;
+                        #pragma omp parallel for schedule(static)
+                        for (size_t i = 0; i < count; ++i) {
+                            if (batch[i].depth == 0)
+                                guides.Record(batch[i].pixel_index, batch[i].r, hits[i], materials);
+                        }
+                    }
 
-                    int tid = omp_get_thread_num();
-                    auto rs = ray_queue[offset + i];
+                    // Shade, bucketed by material
+                    ShadeBatch(ctx, ray_queue.data() + offset, hits.data(), count, next_ray_queue);
 
-                    auto& ps       = pixels[rs.pixel_index];
-                    const auto& rec = hits[i];
-                    const auto& r   = batch_rays[i];
+                    offset += count;
+                }
 
-                    core::Color L = core::Color(0,0,0);
+                ray_queue.clear();
+                ray_queue.swap(next_ray_queue);
+                next_ray_queue.clear();
+            }
+        }
 
-                    // Miss or depth limit
-                    if (!rec.hit || rs.depth >= max_depth) {
-                        L += rs.throughput * background(r);
-                        integrator::RecordSample(ps, L);
-                        if (!ps.converged &&
-                            integrator::IsConverged(ps, kRelThresh, kMinSamples))
-                            ps.converged = true;
-                        continue;
-                    }
+        std::clog << "Sample " << s
+            << "    queue=" << traced << "\n";
 
-                    // Hit emissive
-                    core::Color emitted =
-                        rec.mat->Emitted(rec.u, rec.v, rec.p);
+        // every pixel converged, further passes would trace nothing
+        if (traced == 0 && (budgeted || scheduled))
+            break;
 
-                    if (!emitted.NearZero()) {
-                        L += rs.throughput * emitted;
-                        integrator::RecordSample(ps, L);
-                        if (!ps.converged &&
-                            integrator::IsConverged(ps, kRelThresh, kMinSamples))
-                            ps.converged = true;
-                        continue;
-                    }
+        s_done = s + 1;
 
-                    // BSDF reflections
-                    core::Vec3 wo = -core::Normalize(r.direction());
-                    core::Vec3 wi;
-                    float pdf = 0.0f;
-                    core::Color f;
-
-                    if (!rec.mat->Sample(rec, wo, wi, pdf, f)) {
-                        // no scattering
-                        integrator::RecordSample(ps, L);
-                        if (!ps.converged &&
-                            integrator::IsConverged(ps, kRelThresh, kMinSamples))
-                            ps.converged = true;
-                        continue;
-                    }
+        if (guide && s + 1 == next_refine) {
+            guide->Refine();
+            next_refine = s0 + 2 * (next_refine - s0);
+            std::clog << "Guide: iteration " << guide->Iteration() << ", " << guide->Leaves() << " cells\n";
+        }
+        pass_seconds = pass_clock.elapsed();
+
+        if (budgeted && s + 1 >= kMinSamples) {
+            // root mean square of the pixels' luminance errors
+            double total_error = 0.0;
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    const double e = integrator::LuminanceError(pixels[y * width + x]);
+                    total_error += e * e;
+                }
+            }
+            const double mean_error = std::sqrt(total_error / std::max((x1 - x0) * (y1 - y0), 1));
 
-                    if (ps.converged)
-                        continue;
+            if (noise_target > 0 && mean_error <= noise_target) {
+                time_to_threshold = render_clock.elapsed();
+                std::clog << "Noise target " << noise_target << " reached after " << s + 1 << " samples in "
+                    << time_to_threshold << "s\n";
+            }
 
-                    integrator::RayState child;
-                    child.r           = core::Ray(rec.p, wi);
-                    child.pixel_index = rs.pixel_index;
-                    child.depth       = rs.depth + 1;
-
-                    if (rec.mat->IsSpecular()) {
-                        // delta BSDF: f already encodes the contribution
-                        // DON'T apply cosθ or divide by pdf
-                        child.throughput = rs.throughput * f;
-                    } else {
-                        if (pdf < 1e-6f) {
-                            integrator::RecordSample(ps, L);
-                            if (!ps.converged &&
-                                integrator::IsConverged(ps, kRelThresh, kMinSamples))
-                                ps.converged = true;
-                            continue;
+            if (time_budget > 0 && !scheduled && time_to_threshold < 0) {
+                // 8x8 tiles well below the mean error sit out the next pass.
+                // Tiles rather than pixels: a pixel's own estimate looks
+                // converged until it draws its first bright outlier, so
+                // selecting on it freezes the unlucky pixels dark
+                error.assign(npix, 0.0f);
+                std::vector<float> open;
+                for (int ty = y0; ty < y1; ty += kFocusTile) {
+                    for (int tx = x0; tx < x1; tx += kFocusTile) {
+                        const int ty1 = std::min(ty + kFocusTile, y1);
+                        const int tx1 = std::min(tx + kFocusTile, x1);
+                        double tile_error = 0.0;
+                        bool tile_open = false;
+                        for (int y = ty; y < ty1; ++y) {
+                            for (int x = tx; x < tx1; ++x) {
+                                tile_error += integrator::LuminanceError(pixels[y * width + x]);
+                                tile_open = tile_open || !pixels[y * width + x].converged;
+                            }
                         }
-
-                        float cos_theta = std::max(
-                            0.0f,
-                            static_cast<float>(core::Dot(wi, rec.normal))
-                        );
-
-                        child.throughput = rs.throughput * f * cos_theta / pdf;
+                        tile_error /= (ty1 - ty) * (tx1 - tx);
+                        for (int y = ty; y < ty1; ++y)
+                            std::fill(error.begin() + y * width + tx, error.begin() + y * width + tx1, float(tile_error));
+                        if (tile_open)
+                            open.push_back(float(tile_error));
                     }
+                }
+                double open_error = 0.0;
+                for (float e : open)
+                    open_error += e;
+                cutoff = open.empty() ? 0.0f : float(kFocusCutoff * open_error / open.size());
+            }
+        }
 
-                    // Russian roulette for path termination
-                    if (child.depth > 5) {
-                        double p = std::max({
-                            child.throughput.x(),
-                            child.throughput.y(),
-                            child.throughput.z()
-                        });
-                        p = std::clamp(p, 0.1, 0.95);
-
-                        if (core::RandomDouble() > p) {
-                            integrator::RecordSample(ps, L);
-                            if (!ps.converged &&
-                                integrator::IsConverged(ps, kRelThresh, kMinSamples))
-                                ps.converged = true;
-                            continue;
-                        }
-                        child.throughput /= p;
-                    }
+        // the next pass spreads a uniform pass's samples by error
+        if (scheduled && s + 1 >= kMinSamples) {
+            quota.resize(npix);
+            waves = ScheduleSamples(pixels, width, x0, y0, x1, y1, kFocusTile, s, kMaxPassSamples, quota);
+        }
 
-                    local_queues[tid].push_back(child);
-                }
+        if (progress)
+            progress(s + 1 - s0, s1 - s0);
 
-                // Merge queues
-                for (int t = 0; t < thread_count; t++) {
-                    next_ray_queue.insert(
-                        next_ray_queue.end(),
-                        local_queues[t].begin(),
-                        local_queues[t].end()
-                    );
-                }
+        if (preview && preview_clock.elapsed() >= preview_seconds) {
+            preview->Submit(pixels, s + 1);
+            preview_clock.reset();
+            previewed = s + 1;
+        }
 
-                offset += count;
-            }
+        if (!checkpoint_path.empty() && s + 1 < s1 && checkpoint_clock.elapsed() >= checkpoint_seconds) {
+            if (checkpoint(s + 1))
+                checkpoint_clock.reset();
+        }
 
-            ray_queue.clear();
-            ray_queue.swap(next_ray_queue);
-            next_ray_queue.clear();
+        if (time_to_threshold >= 0)
+            break;
+
+        if (stop_flag && stop_flag->load()) {
+            std::clog << "Stopped after " << s + 1 << " samples\n";
+            break;
         }
     }
 
-    // Write framebuffer
-    for (int i = 0; i < npix; i++) {
-        if (pixels[i].samples > 0)
-            framebuffer[i] =
-                pixels[i].sum / (float)pixels[i].samples;
-        else
-            framebuffer[i] = core::Color(0,0,0);
+    if (time_budget > 0)
+        std::clog << "Time budget: " << s_done - s0 << " passes in " << render_clock.elapsed() << "s\n";
+    if (noise_target > 0 && time_to_threshold < 0)
+        std::clog << "Noise target " << noise_target << " not reached after " << s_done << " samples"
+                  << (budgeted && s_done >= s1 ? " (sample cap)" : "") << "\n";
+    if (cache)
+        std::clog << "Radiance cache: " << cache->CellsUsed() << " cells\n";
+
+    if (preview && previewed != s_done)
+        preview->Submit(pixels, s_done);
+
+    if (!checkpoint_path.empty()) {
+        checkpoints.Wait();
+        checkpoint(s_done);
+        if (checkpoints.Wait())
+            std::clog << "Checkpoint: " << s_done << " samples -> " << checkpoint_path << "\n";
     }
 
-    // Output PPM
-    std::cout << "P3\n" << width << ' ' << height << "\n255\n";
-    for (int j = 0; j < height; ++j)
-        for (int i = 0; i < width; ++i)
-            write_color(std::cout, framebuffer[j * width + i]);
+    // Write framebuffer
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            int i = y * width + x;
+            if (pixels[i].samples > 0)
+                framebuffer[i] =
+                    pixels[i].sum / (float)pixels[i].samples;
+            else
+                framebuffer[i] = core::Color(0,0,0);
+        }
+    }
 }
 
 } // namespace rt::renderer
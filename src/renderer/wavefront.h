@@ -1,12 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <string>
 
 #include "core/color.h"
 #include "integrator/pixel_state.h"
 #include "integrator/ray_state.h"
+#include "renderer/gbuffer.h"
+#include "renderer/renderer.h"
 
 namespace rt::scene {
 class Scene;
@@ -19,7 +24,21 @@ class RayIntegrator;
 
 namespace rt::renderer {
 
-class WavefrontRenderer {
+// how the samples of a pass are spread over the image
+//   kUniform:  one sample for every unconverged pixel
+//   kVariance: after the first 16 passes, a pass's samples (one per pixel
+//              on average) go to 8x8 tiles in proportion to their error, up
+//              to 16 per pixel, so noisy regions converge at the rate of
+//              flat ones
+enum class Schedule {
+    kUniform,
+    kVariance,
+};
+
+// "uniform" or "variance"
+bool ParseSchedule(const std::string& name, Schedule& schedule);
+
+class WavefrontRenderer : public Renderer {
 public:
     WavefrontRenderer(
         const scene::Scene&      world,
@@ -30,7 +49,91 @@ public:
         int batch_size  = 8192
     );
 
-    void Render();   // Only declaration here
+    const char* Name() const override { return "wavefront"; }
+
+    void Render() override;   // Only declaration here
+
+    // Restricts the next Render() to pixels [x0, x1) x [y0, y1) and sample
+    // indices [begin, end), for tiles and sample ranges rendered elsewhere.
+    // Random numbers are keyed by pixel and sample index, so tiles add up to
+    // the full render. A sample range other than [0, max) starts from empty
+    // pixel statistics, so the adaptive test stops it on its own samples and
+    // the merged ranges only estimate the same image. Negative ends mean
+    // "to the edge / max samples".
+    void SetRegion(int x0, int y0, int x1, int y1) override { region[0] = x0; region[1] = y0; region[2] = x1; region[3] = y1; }
+    void SetSampleRange(int begin, int end) override { sample_begin = begin; sample_end = end; }
+
+    // Every `seconds` (checked after each sample pass) the pixel statistics
+    // are copied and written to path in the background, and once more after
+    // the last pass. See renderer/checkpoint.h.
+    void SetCheckpoint(const std::string& path, double seconds) { checkpoint_path = path; checkpoint_seconds = seconds; }
+
+    // written into checkpoints and required of resumed ones, see CheckpointKey
+    void SetCheckpointKey(uint64_t key) { checkpoint_key = key; }
+
+    // Progressive mode: a background thread writes the current estimate to
+    // path after a sample pass once `seconds` have passed since the last
+    // preview (0: after every pass). See renderer/preview.h.
+    void SetPreview(const std::string& path, double seconds) { preview_path = path; preview_seconds = seconds; }
+
+    // Budget modes, both built on the per pixel Welford statistics and not
+    // limited by max samples, only by the cap below:
+    //  - time: passes continue while the next one is expected to finish
+    //    within `seconds`; after the minimum 16 passes, tiles whose error is
+    //    well below the image's mean sit passes out, so the time goes to the
+    //    noisiest regions first.
+    //  - noise: stops once the mean relative error of the pixels' estimates
+    //    drops to rel_error, which is also the per pixel threshold.
+    // 0 turns a mode off; with both set the first one reached ends the render.
+    // Either way a pixel takes at most max_samples (0: 16x the renderer's
+    // max samples), so a target that is never met still ends.
+    void SetTimeBudget(double seconds) { time_budget = seconds; }
+    void SetNoiseTarget(double rel_error) { noise_target = rel_error; }
+    void SetBudgetSampleCap(int max_samples) { budget_max_samples = max_samples; }
+
+    void SetSchedule(Schedule s) { schedule = s; }
+
+    // Path guiding: diffuse bounces sample a spatial-directional radiance
+    // cache learned from the frame's own earlier passes, mixed with cosine
+    // sampling by one-sample MIS (renderer/path_guide.h). Unbiased, but the
+    // image depends on the order threads add to the cache.
+    void SetGuiding(bool enable) { guiding = enable; }
+
+    // Radiance cache: diffuse vertices `bounces` or more bounces deep end
+    // their path with the irradiance a hashed grid has learned there
+    // (renderer/radiance_cache.h). Biased by the cell size, for previews;
+    // 0 turns it off.
+    void SetRadianceCache(int bounces) { cache_bounces = bounces; }
+
+    uint64_t RaysTraced() const override { return rays_traced; }
+
+    // seconds the last render took to reach the noise target, -1 if it did not
+    double TimeToThreshold() const { return time_to_threshold; }
+
+    // Render() returns after the current sample pass once *stop is set
+    // (e.g. from a signal handler); the image then holds the passes so far.
+    void SetStopFlag(const std::atomic<bool>* stop) override { stop_flag = stop; }
+
+    // Starts the next Render() from a checkpoint of the same camera instead
+    // of empty pixels; false if it cannot be read or does not match.
+    bool Resume(const std::string& path);
+
+    // per pixel statistics of the last render, row-major, valid inside the region
+    const std::vector<integrator::PixelState>& Pixels() const override { return pixels; }
+
+    // collects first-hit albedo, normal, depth and ids of every sample
+    // alongside the image: the denoiser's guides (renderer/denoiser.h) and
+    // the first-hit AOVs (renderer/aov.h)
+    void SetCollectGuides(bool collect) { collect_guides = collect; }
+    const GBuffer& Guides() const { return guides; }
+
+    // called after every sample pass with (passes done, total passes)
+    void SetProgress(std::function<void(int, int)> callback) { progress = std::move(callback); }
+
+    // linear radiance of the last render, row-major
+    const std::vector<core::Color>& Framebuffer() const override { return framebuffer; }
+
+    void ReleaseBuffers() override;
 
 private:
     const scene::Scene&   world;
@@ -41,7 +144,36 @@ private:
     int max_ssp;
     int batch_size;
 
-    static rt::core::Color background(const rt::core::Ray& r);
+    std::vector<core::Color> framebuffer;
+    std::vector<integrator::PixelState> pixels;
+
+    bool collect_guides = false;
+    GBuffer guides;
+
+    int region[4] = { 0, 0, -1, -1 };
+    int sample_begin = 0;
+    int sample_end = -1;
+
+    std::string checkpoint_path;
+    double checkpoint_seconds = 0.0;
+    uint64_t checkpoint_key = 0;
+    int resume_sample = -1;   // first sample after a loaded checkpoint
+
+    std::string preview_path;
+    double preview_seconds = 0.0;
+    const std::atomic<bool>* stop_flag = nullptr;
+
+    double time_budget = 0.0;
+    double noise_target = 0.0;
+    int budget_max_samples = 0;
+    double time_to_threshold = -1.0;
+    uint64_t rays_traced = 0;
+
+    Schedule schedule = Schedule::kUniform;
+    bool guiding = false;
+    int cache_bounces = 0;
+
+    std::function<void(int, int)> progress;
 };
 
 } // namespace rt::renderer
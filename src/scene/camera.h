@@ -6,6 +6,7 @@
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include <sched.h>
+#include <stdexcept>
 #include <unordered_map>
 
 #include "core/color.h"
@@ -35,8 +36,12 @@ struct CameraConfig {
 
     double defocus_angle = 0.0;
     double focus_dist    = 10.0;
+
+    core::SampleMode sample_mode = core::SampleMode::kSobol;
 };
 
+// throws json::exception for missing or mistyped fields and
+// std::invalid_argument for an unknown sampler
 inline CameraConfig parseCamera(const json& j) {
     CameraConfig cfg;
     cfg.aspect_ratio = j.value("aspectRatio", cfg.aspect_ratio);
@@ -52,16 +57,43 @@ inline CameraConfig parseCamera(const json& j) {
     cfg.defocus_angle = j.value("defocusAngle", cfg.defocus_angle);
     cfg.focus_dist = j.value("focusDist", cfg.focus_dist);
 
+    if (j.contains("sampler")) {
+        const std::string sampler = j["sampler"].get<std::string>();
+        if (!core::ParseSampleMode(sampler, cfg.sample_mode))
+            throw std::invalid_argument("unknown sampler '" + sampler + "' (independent or sobol)");
+    }
+
     return cfg;
 }
 
+// inverse of parseCamera, for handing a camera to another process
+inline json cameraToJson(const CameraConfig& cfg) {
+    return json{
+        {"aspectRatio", cfg.aspect_ratio},
+        {"imageWidth", cfg.image_width},
+        {"samplesPerPixel", cfg.samples_per_pixel},
+        {"maxDepth", cfg.max_depth},
+        {"vfov", cfg.vfov},
+        {"lookfrom", {cfg.lookfrom.x(), cfg.lookfrom.y(), cfg.lookfrom.z()}},
+        {"lookat", {cfg.lookat.x(), cfg.lookat.y(), cfg.lookat.z()}},
+        {"vup", {cfg.vup.x(), cfg.vup.y(), cfg.vup.z()}},
+        {"defocusAngle", cfg.defocus_angle},
+        {"focusDist", cfg.focus_dist},
+        {"sampler", cfg.sample_mode == core::SampleMode::kIndependent ? "independent" : "sobol"},
+    };
+}
+
 inline std::unordered_map<std::string, CameraConfig> loadCameras(const std::string& filename) {
     std::ifstream f(filename);
     json data = json::parse(f);
 
     std::unordered_map<std::string, CameraConfig> cameras;
     for (auto& [name, cam] : data.items()) {
-        cameras[name] = parseCamera(cam);
+        try {
+            cameras[name] = parseCamera(cam);
+        } catch (const std::invalid_argument& e) {
+            throw std::invalid_argument("camera '" + name + "': " + e.what());
+        }
     }
     return cameras;
 }
@@ -81,6 +113,9 @@ public:
     double defocus_angle_ = 0;
     double focus_dist_ = 10;
 
+    // random stream used for camera and bsdf samples
+    core::SampleMode sample_mode_ = core::SampleMode::kSobol;
+
     void SetFromConfig(const CameraConfig& cfg) {
         aspect_ratio_ = cfg.aspect_ratio;
         image_width_ = cfg.image_width;
@@ -94,6 +129,8 @@ public:
 
         defocus_angle_ = cfg.defocus_angle;
         focus_dist_ = cfg.focus_dist;
+
+        sample_mode_ = cfg.sample_mode;
     }
 
     // initializes private variables from public config
@@ -125,6 +162,9 @@ public:
         auto viewport_upper_left = center_ - (focus_dist_ * w_) - viewport_u/2 - viewport_v/2;
         pixel00_loc_ = viewport_upper_left + 0.5 * (pixel_delta_u_ + pixel_delta_v_);
 
+        // angle covered by one pixel, starting spread of the ray cones
+        pixel_spread_ = std::atan(2 * h / image_height_);
+
         auto defocus_radius = focus_dist_ * std::tan(core::DegreesToRadians(defocus_angle_ / 2));
         defocus_disk_u_ = u_ * defocus_radius;
         defocus_disk_v_ = v_ * defocus_radius;
@@ -181,9 +221,14 @@ public:
         return image_width_;
     }
 
+    double get_pixel_spread() const {
+        return pixel_spread_;
+    }
+
 private:
     int    image_height_;
     double pixel_samples_scale_;
+    double pixel_spread_ = 0.0;
     core::Point3 center_;
     core::Point3 pixel00_loc_;
     core::Vec3 pixel_delta_u_;
@@ -199,7 +244,8 @@ private:
     }
 
     core::Vec3 SampleSquare() const {
-        return core::Vec3(core::RandomDouble() - 0.5, core::RandomDouble() - 0.5, 0);
+        const core::Sample2D xi = core::Random2D();
+        return core::Vec3(xi.u - 0.5, xi.v - 0.5, 0);
     }
 
 };
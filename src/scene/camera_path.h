@@ -0,0 +1,132 @@
+#pragma once
+
+#include "core/vec3.h"
+#include "scene/camera.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rt::scene {
+
+// Camera animation for frame sequences, read from JSON:
+//
+//   {
+//     "frames": 120,                      // default: last keyframe + 1
+//     "interpolation": "linear" | "smooth",
+//     "keyframes": [
+//       { "frame": 0,   "lookfrom": [x,y,z], "lookat": [x,y,z], "vfov": 40 },
+//       { "frame": 119, "lookfrom": [x,y,z], "lookat": [x,y,z] }
+//     ]
+//   }
+//
+// Everything else (resolution, samples, depth, ...) comes from the base
+// camera. A keyframe without "vfov" keeps the base camera's. "smooth" runs a
+// Catmull-Rom spline through the keyframes, so a few keys around an object
+// give a turntable.
+class CameraPath {
+public:
+    bool Load(const std::string& filename) {
+        std::ifstream f(filename);
+        if (!f) {
+            std::cerr << "ERROR: Could not open camera path '" << filename << "'\n";
+            return false;
+        }
+        json doc = json::parse(f, nullptr, false);
+        if (doc.is_discarded() || !doc.contains("keyframes") || !doc["keyframes"].is_array()
+                || doc["keyframes"].empty()) {
+            std::cerr << "ERROR: Camera path '" << filename << "' needs a 'keyframes' array\n";
+            return false;
+        }
+
+        try {
+            keys_.clear();
+            for (const auto& k : doc["keyframes"]) {
+                Key key;
+                key.frame = k.value("frame", keys_.empty() ? 0.0 : keys_.back().frame + 1);
+                key.lookfrom = Vec(k.at("lookfrom"));
+                key.lookat = Vec(k.at("lookat"));
+                key.vfov = k.value("vfov", -1.0);
+                keys_.push_back(key);
+            }
+            smooth_ = doc.value("interpolation", "linear") == "smooth";
+
+            // keyframes may be listed in any order, by default the path
+            // ends at the last of them
+            std::stable_sort(keys_.begin(), keys_.end(),
+                             [](const Key& a, const Key& b) { return a.frame < b.frame; });
+            frames_ = doc.value("frames", int(keys_.back().frame) + 1);
+        } catch (const json::exception& e) {
+            std::cerr << "ERROR: camera path: " << e.what() << "\n";
+            return false;
+        }
+
+        if (frames_ <= 0) {
+            std::cerr << "ERROR: Camera path '" << filename << "' has no frames\n";
+            return false;
+        }
+        return true;
+    }
+
+    int Frames() const { return frames_; }
+
+    // base with the path's view at a frame
+    CameraConfig At(int frame, const CameraConfig& base) const {
+        // segment [i, i + 1] holding the frame, clamped at both ends
+        size_t i = 0;
+        while (i + 2 < keys_.size() && keys_[i + 1].frame <= frame)
+            ++i;
+        const Key& k1 = keys_[i];
+        const Key& k2 = keys_[std::min(i + 1, keys_.size() - 1)];
+        const double span = k2.frame - k1.frame;
+        const double t = span > 0 ? std::clamp((frame - k1.frame) / span, 0.0, 1.0) : 0.0;
+
+        CameraConfig cfg = base;
+        const double fov1 = k1.vfov > 0 ? k1.vfov : base.vfov;
+        const double fov2 = k2.vfov > 0 ? k2.vfov : base.vfov;
+        cfg.vfov = fov1 + t * (fov2 - fov1);
+
+        if (!smooth_) {
+            cfg.lookfrom = k1.lookfrom + t * (k2.lookfrom - k1.lookfrom);
+            cfg.lookat = k1.lookat + t * (k2.lookat - k1.lookat);
+            return cfg;
+        }
+
+        const Key& k0 = keys_[i > 0 ? i - 1 : 0];
+        const Key& k3 = keys_[std::min(i + 2, keys_.size() - 1)];
+        cfg.lookfrom = CatmullRom(k0.lookfrom, k1.lookfrom, k2.lookfrom, k3.lookfrom, t);
+        cfg.lookat = CatmullRom(k0.lookat, k1.lookat, k2.lookat, k3.lookat, t);
+        return cfg;
+    }
+
+private:
+    struct Key {
+        double frame = 0;
+        core::Vec3 lookfrom;
+        core::Vec3 lookat;
+        double vfov = -1;  // unset
+    };
+
+    static core::Vec3 Vec(const json& j) {
+        return core::Vec3(j.at(0).get<double>(), j.at(1).get<double>(), j.at(2).get<double>());
+    }
+
+    // uniform Catmull-Rom between p1 and p2
+    static core::Vec3 CatmullRom(const core::Vec3& p0, const core::Vec3& p1,
+                                 const core::Vec3& p2, const core::Vec3& p3, double t) {
+        const double t2 = t * t;
+        const double t3 = t2 * t;
+        return 0.5 * ((2.0 * p1) + t * (p2 - p0) + t2 * (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3)
+                      + t3 * (3.0 * p1 - p0 - 3.0 * p2 + p3));
+    }
+
+    std::vector<Key> keys_;
+    bool smooth_ = false;
+    int frames_ = 0;
+};
+
+}  // namespace rt::scene
@@ -2,61 +2,344 @@
 #include "third-party/stb/stb_image.h"
 
 #include "scene/image.h"
+#include "scene/tile_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace rt::scene {
 
-Image::Image(const std::string& filename) {
-  if (!Load(filename)) {
+namespace {
+
+// sRGB transfer functions, bytes are decoded through a 256 entry table
+float SrgbToLinear(float c) {
+  return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+unsigned char LinearToSrgbByte(float c) {
+  if (!(c > 0.0f)) return 0;
+  if (c >= 1.0f) return 255;
+  float s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+  return static_cast<unsigned char>(s * 255.0f + 0.5f);
+}
+
+// ---- tiled file layout ----
+// header, one TiledLevel per mip, then each level's tiles back to back
+
+constexpr char kTiledMagic[4] = {'R', 'T', 'T', 'L'};
+constexpr uint32_t kTiledVersion = 1;
+
+struct TiledHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  uint32_t levels;
+  uint32_t tile_size;
+  uint32_t format;
+  uint32_t pad;
+};
+
+struct TiledLevel {
+  int32_t width;
+  int32_t height;
+  int32_t tiles_x;
+  int32_t tiles_y;
+  uint64_t offset;
+};
+
+const std::array<float, 256>& SrgbTable() {
+  static const std::array<float, 256> table = [] {
+    std::array<float, 256> t{};
+    for (int i = 0; i < 256; ++i) t[i] = SrgbToLinear(i / 255.0f);
+    return t;
+  }();
+  return table;
+}
+
+}  // namespace
+
+Image::Image(const std::string& filename, bool hdr) {
+  if (!Load(filename, hdr)) {
     std::cerr << "ERROR: Could not load image '" << filename << "'\n";
   }
 }
 
-bool Image::Load(const std::string& filename) {
-    int n = 3;
-    float* data = nullptr;
+Image::~Image() {
+  if (fd_ >= 0) close(fd_);
+}
 
+std::string Image::ResolvePath(const std::string& filename) {
     // 1. Try direct path first
-    data = stbi_loadf(filename.c_str(), &width_, &height_, &n, 3);
+    std::string path = filename;
 
     // 2. Try project "images" directory
 #ifdef IMAGE_DIR
-    if (!data) {
-        std::string full = std::string(IMAGE_DIR) + "/" + filename;
-        data = stbi_loadf(full.c_str(), &width_, &height_, &n, 3);
-    }
+    if (!std::ifstream(path).good())
+        path = std::string(IMAGE_DIR) + "/" + filename;
 #endif
 
-    // 3. Fail?
-    if (!data) {
-        return false;
-    }
+    return path;
+}
 
-    fdata_.assign(data, data + width_ * height_ * 3);
-    stbi_image_free(data);
-    ConvertToBytes();
+bool Image::Load(const std::string& filename, bool hdr) {
+    const std::string path = ResolvePath(filename);
 
+    levels_.clear();
+    format_ = hdr ? TexelFormat::kFloat : TexelFormat::kSrgb8;
+
+    int n = 3;
+    std::vector<float> linear;
+
+    if (stbi_is_hdr(path.c_str())) {
+        float* data = stbi_loadf(path.c_str(), &width_, &height_, &n, 3);
+        if (!data) return false;
+        linear.assign(data, data + size_t(width_) * height_ * 3);
+        stbi_image_free(data);
+    } else {
+        // 8 bit files are sRGB encoded
+        unsigned char* data = stbi_load(path.c_str(), &width_, &height_, &n, 3);
+        if (!data) return false;
+        const auto& table = SrgbTable();
+        linear.resize(size_t(width_) * height_ * 3);
+        for (size_t i = 0; i < linear.size(); ++i)
+            linear[i] = table[data[i]];
+        stbi_image_free(data);
+    }
+
+    BuildMips(std::move(linear));
     return true;
 }
 
-void Image::ConvertToBytes() {
-  bdata_.resize(width_ * height_ * 3);
+// Box-filters in linear float down to 1x1; only the tiled levels are kept.
+void Image::BuildMips(std::vector<float> level) {
+  int w = width_;
+  int h = height_;
+
+  while (true) {
+    AddLevel(w, h, level);
+
+    if (w == 1 && h == 1) break;
+
+    // odd sizes drop the last row / column
+    int nw = std::max(1, w / 2);
+    int nh = std::max(1, h / 2);
+    std::vector<float> next(size_t(nw) * nh * 3);
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < nh; ++y) {
+      for (int x = 0; x < nw; ++x) {
+        int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+        int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+        for (int c = 0; c < 3; ++c) {
+          next[(size_t(y) * nw + x) * 3 + c] = 0.25f * (
+              level[(size_t(y0) * w + x0) * 3 + c] + level[(size_t(y0) * w + x1) * 3 + c] +
+              level[(size_t(y1) * w + x0) * 3 + c] + level[(size_t(y1) * w + x1) * 3 + c]);
+        }
+      }
+    }
+
+    level.swap(next);
+    w = nw;
+    h = nh;
+  }
+}
+
+void Image::AddLevel(int w, int h, const std::vector<float>& linear) {
+  MipLevel mip;
+  mip.width = w;
+  mip.height = h;
+  mip.tiles_x = (w + kTileSize - 1) / kTileSize;
+  mip.tiles_y = (h + kTileSize - 1) / kTileSize;
+  const size_t count = size_t(mip.tiles_x) * mip.tiles_y * kTileSize * kTileSize * 3;
+
+  if (format_ == TexelFormat::kFloat)
+    mip.floats.assign(count, 0.0f);
+  else
+    mip.bytes.assign(count, 0);
+
+  #pragma omp parallel for schedule(static)
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      const float* src = &linear[(size_t(y) * w + x) * 3];
+      const size_t tile = size_t(y / kTileSize) * mip.tiles_x + x / kTileSize;
+      const size_t dst = (tile * kTileSize * kTileSize
+                          + size_t(y % kTileSize) * kTileSize + x % kTileSize) * 3;
+      for (int c = 0; c < 3; ++c) {
+        if (format_ == TexelFormat::kFloat)
+          mip.floats[dst + c] = src[c];
+        else
+          mip.bytes[dst + c] = LinearToSrgbByte(src[c]);
+      }
+    }
+  }
+
+  levels_.push_back(std::move(mip));
+}
+
+size_t Image::TileBytes() const {
+  const size_t texel = (format_ == TexelFormat::kFloat) ? 3 * sizeof(float) : 3;
+  return size_t(kTileSize) * kTileSize * texel;
+}
+
+const unsigned char* Image::TileData(int level, int x, int y) const {
+  const MipLevel& mip = levels_[level];
+  const size_t tile = size_t(y / kTileSize) * mip.tiles_x + x / kTileSize;
+
+  if (fd_ < 0) {
+    if (format_ == TexelFormat::kFloat)
+      return reinterpret_cast<const unsigned char*>(mip.floats.data()) + tile * TileBytes();
+    return mip.bytes.data() + tile * TileBytes();
+  }
+
+  // the last tile is kept per thread, so neighbouring lookups skip the cache
+  // lock; it also keeps the returned data alive until the next call
+  thread_local uint64_t last_key = ~0ull;
+  thread_local std::shared_ptr<const TileCache::Tile> last_tile;
+
+  const uint64_t key = (uint64_t(cache_id_) << 40) | (uint64_t(level) << 32) | tile;
+  if (key != last_key || !last_tile) {
+    const size_t bytes = TileBytes();
+    const off_t offset = off_t(mip.file_offset + tile * bytes);
+    const int fd = fd_;
+    last_tile = TileCache::Global().Fetch(key, [&](TileCache::Tile& data) {
+      data.resize(bytes);
+      return pread(fd, data.data(), bytes, offset) == ssize_t(bytes);
+    });
+    last_key = key;
+  }
+
+  if (!last_tile) {
+    last_key = ~0ull;
+    return nullptr;
+  }
+  return last_tile->data();
+}
+
+core::Color Image::Texel(int x, int y, int level) const {
+  if (levels_.empty()) {
+    return core::Color(1, 0, 1);  // magenta
+  }
+
+  level = Clamp(level, 0, Levels());
+  const MipLevel& mip = levels_[level];
+  x = Clamp(x, 0, mip.width);
+  y = Clamp(y, 0, mip.height);
+
+  const unsigned char* tile = TileData(level, x, y);
+  if (!tile) {
+    return core::Color(1, 0, 1);  // unreadable tile
+  }
+  const size_t in_tile = size_t(y % kTileSize) * kTileSize + x % kTileSize;
+
+  if (format_ == TexelFormat::kFloat) {
+    float t[3];
+    std::memcpy(t, tile + in_tile * 3 * sizeof(float), sizeof(t));
+    return core::Color(t[0], t[1], t[2]);
+  }
+
+  const auto& table = SrgbTable();
+  const unsigned char* t = tile + in_tile * 3;
+  return core::Color(table[t[0]], table[t[1]], table[t[2]]);
+}
+
+size_t Image::MemoryBytes() const {
+  size_t bytes = 0;
+  for (const auto& mip : levels_)
+    bytes += mip.bytes.size() + mip.floats.size() * sizeof(float);
+  return bytes;
+}
+
+// ---- out-of-core storage ----
+
+bool Image::WriteTiled(const std::string& path) const {
+  if (levels_.empty() || fd_ >= 0) return false;
+
+  // written under a temporary name so readers never see a partial file
+  const std::string tmp = path + ".tmp";
+  std::ofstream out(tmp, std::ios::binary);
+  if (!out) return false;
+
+  TiledHeader header{};
+  std::memcpy(header.magic, kTiledMagic, 4);
+  header.version = kTiledVersion;
+  header.width = width_;
+  header.height = height_;
+  header.levels = uint32_t(levels_.size());
+  header.tile_size = kTileSize;
+  header.format = uint32_t(format_);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  uint64_t offset = sizeof(TiledHeader) + levels_.size() * sizeof(TiledLevel);
+  for (const auto& mip : levels_) {
+    TiledLevel level{ mip.width, mip.height, mip.tiles_x, mip.tiles_y, offset };
+    out.write(reinterpret_cast<const char*>(&level), sizeof(level));
+    offset += size_t(mip.tiles_x) * mip.tiles_y * TileBytes();
+  }
 
-  for (size_t i = 0; i < bdata_.size(); ++i)
-    bdata_[i] = FloatToByte(fdata_[i]);
+  for (const auto& mip : levels_) {
+    if (format_ == TexelFormat::kFloat)
+      out.write(reinterpret_cast<const char*>(mip.floats.data()), mip.floats.size() * sizeof(float));
+    else
+      out.write(reinterpret_cast<const char*>(mip.bytes.data()), mip.bytes.size());
+  }
+
+  out.close();
+  if (!out) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
 }
 
-const unsigned char* Image::PixelData(int x, int y) const {
-  if (bdata_.empty()) {
-    static unsigned char magenta[3] = {255, 0, 255};
-    return magenta;
+bool Image::OpenTiled(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  TiledHeader header{};
+  if (pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) ||
+      std::memcmp(header.magic, kTiledMagic, 4) != 0 ||
+      header.version != kTiledVersion ||
+      header.tile_size != uint32_t(kTileSize) ||
+      header.levels == 0 || header.levels > 32) {
+    close(fd);
+    return false;
   }
 
-  x = Clamp(x, 0, width_);
-  y = Clamp(y, 0, height_);
+  std::vector<TiledLevel> table(header.levels);
+  const ssize_t table_bytes = ssize_t(table.size() * sizeof(TiledLevel));
+  if (pread(fd, table.data(), table_bytes, sizeof(header)) != table_bytes) {
+    close(fd);
+    return false;
+  }
 
-  return &bdata_[(y * width_ + x) * 3];
+  if (fd_ >= 0) close(fd_);
+  fd_ = fd;
+  cache_id_ = TileCache::Global().NewImageId();
+  width_ = header.width;
+  height_ = header.height;
+  format_ = TexelFormat(header.format);
+
+  levels_.clear();
+  for (const auto& t : table) {
+    MipLevel mip;
+    mip.width = t.width;
+    mip.height = t.height;
+    mip.tiles_x = t.tiles_x;
+    mip.tiles_y = t.tiles_y;
+    mip.file_offset = t.offset;
+    levels_.push_back(std::move(mip));
+  }
+  return true;
 }
 
 // helpers
@@ -66,10 +349,4 @@ int Image::Clamp(int x, int low, int high) {
   return high - 1;
 }
 
-unsigned char Image::FloatToByte(float value) {
-  if (value <= 0.0f) return 0;
-  if (value >= 1.0f) return 255;
-  return static_cast<unsigned char>(value * 255.999f);
-}
-
 }  // namespace rt::scene
@@ -1,31 +1,94 @@
 #pragma once
+#include "core/color.h"
+
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace rt::scene {
 
+// How texels are kept in memory.
+// kSrgb8 stores 3 bytes per texel in sRGB encoding (decoded through a table on
+// lookup), kFloat keeps linear floats and is only used for HDR textures.
+enum class TexelFormat { kSrgb8, kFloat };
+
+// Read-only texture image with a mip pyramid.
+// Every level is stored in square tiles of kTileSize texels, so a lookup and
+// its neighbours usually stay within one tile (a few contiguous cache lines)
+// instead of rows that are a whole image width apart.
 class Image {
  public:
+  static constexpr int kTileSize = 16;
+
   Image() = default;
-  explicit Image(const std::string& filename);
+  explicit Image(const std::string& filename, bool hdr = false);
+  ~Image();
+
+  Image(const Image&) = delete;
+  Image& operator=(const Image&) = delete;
+
+  // hdr keeps linear float texels; otherwise texels are sRGB bytes and the
+  // float data only lives while the mips are built
+  bool Load(const std::string& filename, bool hdr = false);
+
+  // ---- out-of-core storage ----
+  // The tiled file is the in-memory tile layout written as is, behind a
+  // small header. An opened tiled image holds no texels: tiles are read on
+  // first touch through the shared TileCache.
+  bool WriteTiled(const std::string& path) const;
+  bool OpenTiled(const std::string& path);
+  bool Streamed() const { return fd_ >= 0; }
 
-  bool Load(const std::string& filename);
+  // filename as given, or under IMAGE_DIR when it does not exist
+  static std::string ResolvePath(const std::string& filename);
 
   int Width() const { return width_; }
   int Height() const { return height_; }
+  TexelFormat Format() const { return format_; }
 
-  const unsigned char* PixelData(int x, int y) const;
+  // mip pyramid, level 0 is full resolution, each level halves both sides
+  int Levels() const { return static_cast<int>(levels_.size()); }
+  int Width(int level) const { return levels_[level].width; }
+  int Height(int level) const { return levels_[level].height; }
+
+  // linear rgb of a texel, coordinates and level are clamped
+  core::Color Texel(int x, int y) const { return Texel(x, y, 0); }
+  core::Color Texel(int x, int y, int level) const;
+
+  // bytes held by the texel storage, 0 for streamed images
+  size_t MemoryBytes() const;
 
  private:
+  struct MipLevel {
+    int width = 0;
+    int height = 0;
+    int tiles_x = 0;
+    int tiles_y = 0;
+    std::vector<unsigned char> bytes;  // kSrgb8, tiled rgb
+    std::vector<float> floats;         // kFloat, tiled rgb
+    uint64_t file_offset = 0;          // first tile, when streamed
+  };
+
   static int Clamp(int x, int low, int high);
-  static unsigned char FloatToByte(float value);
-  void ConvertToBytes();
+  size_t TileBytes() const;
+
+  // start of the tile holding texel (x, y), reading it in when streamed
+  // nullptr if a streamed tile cannot be read
+  const unsigned char* TileData(int level, int x, int y) const;
+
+  // linear rgb rows -> tiled level in this image's format
+  void AddLevel(int w, int h, const std::vector<float>& linear);
+  void BuildMips(std::vector<float> linear);
 
   int width_ = 0;
   int height_ = 0;
+  TexelFormat format_ = TexelFormat::kSrgb8;
+
+  std::vector<MipLevel> levels_;
 
-  std::vector<float> fdata_;
-  std::vector<unsigned char> bdata_;
+  int fd_ = -1;
+  uint32_t cache_id_ = 0;
 };
 
 }  // namespace rt::scene
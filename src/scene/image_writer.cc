@@ -0,0 +1,244 @@
+#include "scene/image_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace rt::scene {
+
+namespace {
+
+// same tonemapping as core::write_color, without the formatted output
+unsigned char ToByte(double linear) {
+    static const core::Interval intensity(0.000, 0.999);
+    return static_cast<unsigned char>(256 * intensity.Clamp(core::linear_to_gamma(linear)));
+}
+
+void AppendHeader(std::vector<unsigned char>& buf, const std::string& header) {
+    buf.insert(buf.end(), header.begin(), header.end());
+}
+
+void AppendBe32(std::vector<unsigned char>& buf, uint32_t v) {
+    buf.push_back(static_cast<unsigned char>(v >> 24));
+    buf.push_back(static_cast<unsigned char>(v >> 16));
+    buf.push_back(static_cast<unsigned char>(v >> 8));
+    buf.push_back(static_cast<unsigned char>(v));
+}
+
+// 8 bit RGB rows, converted in parallel
+// stride lets png reserve its leading filter byte per row
+void ConvertToBytes(const std::vector<core::Color>& pixels, int width, int height,
+                    unsigned char* out, size_t row_stride, size_t row_offset) {
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        unsigned char* row = out + y * row_stride + row_offset;
+        for (int x = 0; x < width; ++x) {
+            const core::Color& c = pixels[y * width + x];
+            row[3 * x + 0] = ToByte(c.x());
+            row[3 * x + 1] = ToByte(c.y());
+            row[3 * x + 2] = ToByte(c.z());
+        }
+    }
+}
+
+// ---------------- PPM (P6) ----------------
+
+std::vector<unsigned char> EncodePpm(const std::vector<core::Color>& pixels, int width, int height) {
+    std::vector<unsigned char> buf;
+    AppendHeader(buf, "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n");
+
+    size_t offset = buf.size();
+    buf.resize(offset + size_t(width) * height * 3);
+    ConvertToBytes(pixels, width, height, buf.data() + offset, size_t(width) * 3, 0);
+    return buf;
+}
+
+// ---------------- PFM ----------------
+
+std::vector<unsigned char> EncodePfm(const std::vector<core::Color>& pixels, int width, int height) {
+    std::vector<unsigned char> buf;
+    // negative scale marks little-endian data
+    AppendHeader(buf, "PF\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n-1.0\n");
+
+    size_t offset = buf.size();
+    buf.resize(offset + size_t(width) * height * 3 * sizeof(float));
+
+    // pfm stores scanlines bottom to top
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        const int src_row = height - 1 - y;
+        float* row = reinterpret_cast<float*>(buf.data() + offset) + size_t(y) * width * 3;
+        for (int x = 0; x < width; ++x) {
+            const core::Color& c = pixels[src_row * width + x];
+            float rgb[3] = { float(c.x()), float(c.y()), float(c.z()) };
+            std::memcpy(row + 3 * x, rgb, sizeof(rgb));
+        }
+    }
+    return buf;
+}
+
+// ---------------- PNG ----------------
+//
+// No zlib in the tree, so the image data is stored in uncompressed deflate
+// blocks. This keeps the writer dependency free; files are roughly the size
+// of a P6 ppm.
+
+uint32_t Crc32(const unsigned char* data, size_t len, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t Adler32(const unsigned char* data, size_t len) {
+    constexpr uint32_t kMod = 65521;
+    uint32_t a = 1, b = 0;
+    while (len > 0) {
+        // 5552 is the largest block that cannot overflow b
+        size_t block = std::min<size_t>(len, 5552);
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= kMod;
+        b %= kMod;
+        data += block;
+        len -= block;
+    }
+    return (b << 16) | a;
+}
+
+void AppendChunk(std::vector<unsigned char>& buf, const char type[4],
+                 const unsigned char* data, size_t len) {
+    AppendBe32(buf, static_cast<uint32_t>(len));
+    size_t start = buf.size();
+    buf.insert(buf.end(), type, type + 4);
+    buf.insert(buf.end(), data, data + len);
+    AppendBe32(buf, Crc32(buf.data() + start, len + 4));
+}
+
+std::vector<unsigned char> EncodePng(const std::vector<core::Color>& pixels, int width, int height) {
+    // raw scanlines, each prefixed with filter type 0 (none)
+    const size_t row_stride = size_t(width) * 3 + 1;
+    std::vector<unsigned char> raw(row_stride * height, 0);
+    ConvertToBytes(pixels, width, height, raw.data(), row_stride, 1);
+
+    // zlib stream of stored deflate blocks
+    constexpr size_t kMaxBlock = 65535;
+    std::vector<unsigned char> z;
+    z.reserve(raw.size() + raw.size() / kMaxBlock * 5 + 16);
+    z.push_back(0x78);
+    z.push_back(0x01);
+
+    size_t pos = 0;
+    do {
+        size_t len = std::min(kMaxBlock, raw.size() - pos);
+        bool last = pos + len == raw.size();
+        z.push_back(last ? 1 : 0);
+        z.push_back(static_cast<unsigned char>(len));
+        z.push_back(static_cast<unsigned char>(len >> 8));
+        z.push_back(static_cast<unsigned char>(~len));
+        z.push_back(static_cast<unsigned char>(~len >> 8));
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+    AppendBe32(z, Adler32(raw.data(), raw.size()));
+
+    std::vector<unsigned char> buf;
+    buf.reserve(z.size() + 64);
+    static const unsigned char kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    buf.insert(buf.end(), kSignature, kSignature + 8);
+
+    std::vector<unsigned char> ihdr;
+    AppendBe32(ihdr, static_cast<uint32_t>(width));
+    AppendBe32(ihdr, static_cast<uint32_t>(height));
+    ihdr.push_back(8);  // bit depth
+    ihdr.push_back(2);  // color type: RGB
+    ihdr.push_back(0);  // compression
+    ihdr.push_back(0);  // filter
+    ihdr.push_back(0);  // interlace
+    AppendChunk(buf, "IHDR", ihdr.data(), ihdr.size());
+    AppendChunk(buf, "IDAT", z.data(), z.size());
+    AppendChunk(buf, "IEND", nullptr, 0);
+    return buf;
+}
+
+}  // namespace
+
+bool FormatFromPath(const std::string& path, ImageFormat& format) {
+    // a dot in a directory name is not an extension
+    const auto dot = path.find_last_of('.');
+    const auto slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        format = ImageFormat::kPpm;
+        return true;
+    }
+
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+
+    if (ext == "ppm")
+        format = ImageFormat::kPpm;
+    else if (ext == "png")
+        format = ImageFormat::kPng;
+    else if (ext == "pfm")
+        format = ImageFormat::kPfm;
+    else {
+        std::cerr << "ERROR: Unknown image format '." << ext << "' of '" << path << "' (ppm, png or pfm)\n";
+        return false;
+    }
+    return true;
+}
+
+bool WriteImage(std::ostream& out, ImageFormat format,
+                const std::vector<core::Color>& pixels, int width, int height) {
+    if (width <= 0 || height <= 0 || pixels.size() < size_t(width) * height)
+        return false;
+
+    std::vector<unsigned char> buf;
+    switch (format) {
+        case ImageFormat::kPpm: buf = EncodePpm(pixels, width, height); break;
+        case ImageFormat::kPng: buf = EncodePng(pixels, width, height); break;
+        case ImageFormat::kPfm: buf = EncodePfm(pixels, width, height); break;
+    }
+
+    out.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+bool WriteImage(const std::string& path,
+                const std::vector<core::Color>& pixels, int width, int height) {
+    if (path.empty() || path == "-")
+        return WriteImage(std::cout, ImageFormat::kPpm, pixels, width, height);
+
+    ImageFormat format;
+    if (!FormatFromPath(path, format))
+        return false;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "ERROR: Could not open '" << path << "' for writing\n";
+        return false;
+    }
+    return WriteImage(file, format, pixels, width, height);
+}
+
+}  // namespace rt::scene
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "core/color.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace rt::scene {
+
+// supported framebuffer output formats
+// kPpm: binary P6, 8 bit gamma corrected
+// kPng: 8 bit RGB, gamma corrected
+// kPfm: 32 bit float linear radiance (HDR)
+enum class ImageFormat {
+    kPpm,
+    kPng,
+    kPfm,
+};
+
+// picks the format from the file extension (.ppm, .png, .pfm), no
+// extension means ppm; false (with an error) for any other extension
+bool FormatFromPath(const std::string& path, ImageFormat& format);
+
+// encodes the whole image into memory and writes it with a single bulk write
+// pixels are row-major, top row first, in linear radiance
+bool WriteImage(std::ostream& out, ImageFormat format,
+                const std::vector<core::Color>& pixels, int width, int height);
+
+// writes to path, format chosen by extension
+// an empty path or "-" writes binary ppm to stdout
+bool WriteImage(const std::string& path,
+                const std::vector<core::Color>& pixels, int width, int height);
+
+}  // namespace rt::scene
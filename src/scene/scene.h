@@ -10,6 +10,8 @@
 #include "geom/aabb.h"
 #include "geom/hittable.h"
 
+#include "material/material_table.h"
+
 namespace rt::scene {
 
 class Scene : public geom::Hittable {
@@ -69,8 +71,32 @@ class Scene : public geom::Hittable {
   int ObjectIndex() const override { return -1; }
   void set_object_index(int) override {}
 
+  void BindMaterials(material::MaterialTable& table) override {
+    for (const auto& object : objects_) {
+      object->BindMaterials(table);
+    }
+  }
+
+  void Record(geom::PrimitiveList& list) const override {
+    for (const auto& object : objects_) {
+      object->Record(list);
+    }
+  }
+
+  // Collects the materials of every object into this scene's table and hands
+  // the ids to the primitives. Call once on the root scene after building it.
+  void BuildMaterialTable() {
+    materials_.Clear();
+    BindMaterials(materials_);
+  }
+
+  const material::MaterialTable& Materials() const {
+    return materials_;
+  }
+
  private:
     geom::Aabb bbox_;
+    material::MaterialTable materials_;
 };
 
 }  // namespace rt::scene
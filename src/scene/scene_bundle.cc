@@ -0,0 +1,621 @@
+#include "scene/scene_bundle.h"
+
+#include "core/timer.h"
+#include "geom/bvh.h"
+#include "geom/primitive_record.h"
+#include "geom/rect.h"
+#include "geom/sphere.h"
+#include "geom/triangle.h"
+#include "material/material_table.h"
+#include "scene/scene.h"
+#include "scene/texture_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rt::scene {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr char     kBundleMagic[8] = { 'R', 'T', 'B', 'U', 'N', 'D', 'L', 'E' };
+constexpr uint32_t kBundleVersion  = 1;
+constexpr uint64_t kSectionAlign   = 64;
+
+struct Section {
+    uint64_t offset = 0;  // from the start of the file, kSectionAlign aligned
+    uint64_t count  = 0;  // elements
+};
+
+// material and texture records without pointers
+struct BundleMaterial {
+    material::MaterialType type;
+    uint32_t texture;
+    double   albedo[3];
+    double   fuzz;
+    double   ior;
+};
+
+struct BundleTexture {
+    material::TextureType type;
+    uint32_t even;
+    uint32_t odd;
+    uint32_t image;       // index into the image section
+    double   color[3];
+    double   inv_scale;
+};
+
+struct BundleImage {
+    uint32_t path_offset;  // into the string section
+    uint32_t path_length;
+    uint32_t hdr;
+    uint32_t pad;
+};
+
+struct BundleHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;  // layout checks, a bundle is a same-build cache
+    uint32_t vertex_size;
+    uint32_t node_size;
+    int32_t  root;         // Bvh root node, -1 when empty
+    uint32_t pad;
+    uint64_t triangles;
+
+    Section materials;
+    Section textures;
+    Section images;
+    Section strings;
+    Section primitives;
+    Section vertices;
+    Section nodes;
+    Section prim_indices;
+};
+
+// stands in for a record while the Bvh is built, with the primitive's own box
+class BoundsProxy : public geom::Hittable {
+public:
+    explicit BoundsProxy(const geom::Aabb& box) : box_(box) {}
+
+    bool Hit(const core::Ray&, core::Interval, geom::HitRecord&) const override { return false; }
+    geom::Aabb BoundingBox() const override { return box_; }
+    int TypeId() const override { return -1; }
+    int ObjectIndex() const override { return -1; }
+    void set_object_index(int) override {}
+
+private:
+    geom::Aabb box_;
+};
+
+geom::Aabb RecordBounds(const geom::PrimitiveRecord& r, const core::Point3* vertices) {
+    const double* d = r.data;
+    switch (r.type) {
+        case geom::PrimitiveType::kSphere:
+            return geom::Sphere::Bounds(core::Point3(d[0], d[1], d[2]), d[3]);
+        case geom::PrimitiveType::kXyRect:
+            return geom::xy_rect::Bounds(d[0], d[1], d[2], d[3], d[4]);
+        case geom::PrimitiveType::kXzRect:
+            return geom::xz_rect::Bounds(d[0], d[1], d[2], d[3], d[4]);
+        case geom::PrimitiveType::kYzRect:
+            return geom::yz_rect::Bounds(d[0], d[1], d[2], d[3], d[4]);
+        case geom::PrimitiveType::kTriangle:
+            return geom::Triangle::Bounds(vertices[r.index[0]], vertices[r.index[1]], vertices[r.index[2]]);
+    }
+    return geom::Aabb();
+}
+
+// ---------------- Mapped geometry ----------------
+
+// The whole bundle as one Hittable. Records, vertices and Bvh nodes are read
+// in place from the mapping; pages are faulted in as rays reach them.
+class BundleGeometry : public geom::Hittable {
+public:
+    BundleGeometry() = default;
+    BundleGeometry(const BundleGeometry&) = delete;
+    BundleGeometry& operator=(const BundleGeometry&) = delete;
+
+    ~BundleGeometry() override {
+        if (map_) munmap(map_, size_);
+    }
+
+    bool Open(const std::string& path);
+
+    bool Hit(const core::Ray& r, core::Interval ray_t, geom::HitRecord& rec) const override {
+        if (header_->root < 0)
+            return false;
+
+        return geom::Bvh::Traverse(nodes_, header_->root, prim_indices_, r, ray_t, rec,
+            [this](int prim_idx, const core::Ray& ray, core::Interval t, geom::HitRecord& out) {
+                return HitPrimitive(prims_[prim_idx], ray, t, out);
+            });
+    }
+
+    geom::Aabb BoundingBox() const override {
+        return header_->root < 0 ? geom::Aabb() : nodes_[header_->root].bbox;
+    }
+
+    int TypeId() const override { return -1; }
+    int ObjectIndex() const override { return -1; }
+    void set_object_index(int) override {}
+
+    // appends the bundle's records, ids in the file are relative to its own tables
+    void BindMaterials(material::MaterialTable& table) override;
+
+    // the mapped records, with material ids rebased like HitPrimitive's
+    void Record(geom::PrimitiveList& list) const override;
+
+    size_t Primitives() const { return header_->primitives.count; }
+    size_t Triangles() const { return header_->triangles; }
+    size_t Materials() const { return header_->materials.count; }
+
+private:
+    bool HitPrimitive(const geom::PrimitiveRecord& p, const core::Ray& r, core::Interval ray_t,
+                      geom::HitRecord& rec) const {
+        const double* d = p.data;
+        bool hit = false;
+        switch (p.type) {
+            case geom::PrimitiveType::kSphere:
+                hit = geom::Sphere::Intersect(core::Point3(d[0], d[1], d[2]), d[3], r, ray_t, rec);
+                break;
+            case geom::PrimitiveType::kXyRect:
+                hit = geom::xy_rect::Intersect(d[0], d[1], d[2], d[3], d[4], r, ray_t, rec);
+                break;
+            case geom::PrimitiveType::kXzRect:
+                hit = geom::xz_rect::Intersect(d[0], d[1], d[2], d[3], d[4], r, ray_t, rec);
+                break;
+            case geom::PrimitiveType::kYzRect:
+                hit = geom::yz_rect::Intersect(d[0], d[1], d[2], d[3], d[4], r, ray_t, rec);
+                break;
+            case geom::PrimitiveType::kTriangle:
+                hit = geom::Triangle::Intersect(vertices_[p.index[0]], vertices_[p.index[1]],
+                                                vertices_[p.index[2]], r, ray_t, rec);
+                break;
+        }
+        if (!hit)
+            return false;
+
+        rec.mat = nullptr;
+        rec.mat_id = mat_base_ + p.mat_id;
+        return true;
+    }
+
+    template <class T>
+    const T* SectionData(const Section& s) const {
+        return reinterpret_cast<const T*>(static_cast<const char*>(map_) + s.offset);
+    }
+
+    template <class T>
+    bool SectionFits(const Section& s) const {
+        return s.offset % kSectionAlign == 0 && s.offset <= size_ &&
+               s.count <= (size_ - s.offset) / sizeof(T);
+    }
+
+    // every id the renderer follows, checked once so Hit and the material
+    // table never leave their sections; nullptr or what is wrong
+    const char* Validate() const;
+
+    void*  map_  = nullptr;
+    size_t size_ = 0;
+
+    const BundleHeader*          header_ = nullptr;
+    const geom::PrimitiveRecord* prims_ = nullptr;
+    const core::Point3*          vertices_ = nullptr;
+    const geom::BvhNodeGPU*      nodes_ = nullptr;
+    const int*                   prim_indices_ = nullptr;
+
+    std::vector<std::shared_ptr<const Image>> images_;
+    uint32_t mat_base_ = 0;
+};
+
+bool BundleGeometry::Open(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "ERROR: Could not open scene bundle '" << path << "'\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(BundleHeader)) {
+        std::cerr << "ERROR: Scene bundle '" << path << "' is truncated\n";
+        close(fd);
+        return false;
+    }
+
+    size_ = size_t(st.st_size);
+    map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        std::cerr << "ERROR: Could not map scene bundle '" << path << "'\n";
+        return false;
+    }
+    // start reading ahead in the background, rendering does not wait for it
+    madvise(map_, size_, MADV_WILLNEED);
+
+    header_ = static_cast<const BundleHeader*>(map_);
+    const BundleHeader& h = *header_;
+    if (std::memcmp(h.magic, kBundleMagic, sizeof(kBundleMagic)) != 0 ||
+        h.version != kBundleVersion ||
+        h.record_size != sizeof(geom::PrimitiveRecord) ||
+        h.vertex_size != sizeof(core::Point3) ||
+        h.node_size != sizeof(geom::BvhNodeGPU)) {
+        std::cerr << "ERROR: '" << path << "' is not a scene bundle of this version, rebuild it\n";
+        return false;
+    }
+    if (!SectionFits<BundleMaterial>(h.materials) || !SectionFits<BundleTexture>(h.textures) ||
+        !SectionFits<BundleImage>(h.images) || !SectionFits<char>(h.strings) ||
+        !SectionFits<geom::PrimitiveRecord>(h.primitives) || !SectionFits<core::Point3>(h.vertices) ||
+        !SectionFits<geom::BvhNodeGPU>(h.nodes) || !SectionFits<int>(h.prim_indices) ||
+        h.root >= int64_t(h.nodes.count)) {
+        std::cerr << "ERROR: Scene bundle '" << path << "' is truncated\n";
+        return false;
+    }
+
+    prims_        = SectionData<geom::PrimitiveRecord>(h.primitives);
+    vertices_     = SectionData<core::Point3>(h.vertices);
+    nodes_        = SectionData<geom::BvhNodeGPU>(h.nodes);
+    prim_indices_ = SectionData<int>(h.prim_indices);
+
+    if (const char* error = Validate()) {
+        std::cerr << "ERROR: Scene bundle '" << path << "' is corrupt: " << error << "\n";
+        return false;
+    }
+
+    // image paths are stored relative to the bundle
+    const fs::path dir = fs::path(path).parent_path();
+    const BundleImage* images = SectionData<BundleImage>(h.images);
+    const char* strings = SectionData<char>(h.strings);
+    for (uint64_t i = 0; i < h.images.count; ++i) {
+        const BundleImage& img = images[i];
+        if (uint64_t(img.path_offset) + img.path_length > h.strings.count) {
+            std::cerr << "ERROR: Scene bundle '" << path << "' is truncated\n";
+            return false;
+        }
+        fs::path file(std::string(strings + img.path_offset, img.path_length));
+        if (file.is_relative())
+            file = dir / file;
+        images_.push_back(TextureCache::Global().Get(file.lexically_normal().string(), img.hdr != 0));
+    }
+    return true;
+}
+
+const char* BundleGeometry::Validate() const {
+    using material::kInvalidId;
+    const BundleHeader& h = *header_;
+
+    // Bvh: a tree below the root, shallow enough for Traverse's stack, with
+    // leaves inside the index section and indices naming primitives
+    constexpr int kMaxBvhDepth = 62;  // Traverse holds at most depth + 2 entries
+    if (h.root >= 0) {
+        std::vector<uint8_t> seen(h.nodes.count, 0);
+        std::vector<std::pair<uint32_t, int>> stack = { { uint32_t(h.root), 0 } };
+        while (!stack.empty()) {
+            const auto [n, depth] = stack.back();
+            stack.pop_back();
+            if (n >= h.nodes.count)
+                return "Bvh child out of range";
+            if (seen[n]++)
+                return "Bvh node reached twice";
+            if (depth > kMaxBvhDepth)
+                return "Bvh too deep";
+            const geom::BvhNodeGPU& node = nodes_[n];
+            if (node.isLeaf) {
+                if (uint64_t(node.left_pIdx) + node.right_pCnt > h.prim_indices.count)
+                    return "Bvh leaf out of range";
+            } else {
+                stack.push_back({ node.left_pIdx, depth + 1 });
+                stack.push_back({ node.right_pCnt, depth + 1 });
+            }
+        }
+    }
+    for (uint64_t i = 0; i < h.prim_indices.count; ++i) {
+        if (prim_indices_[i] < 0 || uint64_t(prim_indices_[i]) >= h.primitives.count)
+            return "primitive index out of range";
+    }
+
+    for (uint64_t i = 0; i < h.primitives.count; ++i) {
+        const geom::PrimitiveRecord& p = prims_[i];
+        if (uint32_t(p.type) > uint32_t(geom::PrimitiveType::kTriangle))
+            return "unknown primitive type";
+        if (p.mat_id >= h.materials.count)
+            return "material id out of range";
+        if (p.type == geom::PrimitiveType::kTriangle &&
+            (p.index[0] >= h.vertices.count || p.index[1] >= h.vertices.count || p.index[2] >= h.vertices.count))
+            return "vertex index out of range";
+    }
+
+    // lambertians and lights evaluate their texture, metals and glass have none
+    const BundleMaterial* materials = SectionData<BundleMaterial>(h.materials);
+    for (uint64_t i = 0; i < h.materials.count; ++i) {
+        const BundleMaterial& m = materials[i];
+        if (uint32_t(m.type) > uint32_t(material::MaterialType::kDiffuseLight))
+            return "unknown material type";
+        const bool textured = m.type == material::MaterialType::kLambertian ||
+                              m.type == material::MaterialType::kDiffuseLight;
+        if (m.texture >= h.textures.count && (textured || m.texture != kInvalidId))
+            return "texture id out of range";
+    }
+
+    const BundleTexture* textures = SectionData<BundleTexture>(h.textures);
+    for (uint64_t i = 0; i < h.textures.count; ++i) {
+        const BundleTexture& t = textures[i];
+        if (uint32_t(t.type) > uint32_t(material::TextureType::kImage))
+            return "unknown texture type";
+        if (t.type == material::TextureType::kChecker && (t.even >= h.textures.count || t.odd >= h.textures.count))
+            return "checker texture id out of range";
+        if (t.type == material::TextureType::kImage && t.image >= h.images.count)
+            return "image id out of range";
+    }
+
+    // EvalTexture follows checker chains until a leaf, so they must not loop:
+    // depth first over the checkers, 1 = on the current chain, 2 = done
+    std::vector<uint8_t> state(h.textures.count, 0);
+    for (uint64_t start = 0; start < h.textures.count; ++start) {
+        std::vector<std::pair<uint32_t, int>> stack = { { uint32_t(start), 0 } };
+        while (!stack.empty()) {
+            auto& [t, child] = stack.back();
+            if (textures[t].type != material::TextureType::kChecker || child == 2) {
+                state[t] = 2;
+                stack.pop_back();
+                continue;
+            }
+            if (child == 0) {
+                if (state[t] == 2) {
+                    stack.pop_back();
+                    continue;
+                }
+                state[t] = 1;
+            }
+            const uint32_t next = child++ == 0 ? textures[t].even : textures[t].odd;
+            if (state[next] == 1)
+                return "checker textures form a cycle";
+            if (state[next] == 0)
+                stack.push_back({ next, 0 });
+        }
+    }
+    return nullptr;
+}
+
+void BundleGeometry::Record(geom::PrimitiveList& list) const {
+    for (uint64_t i = 0; i < header_->primitives.count; ++i) {
+        const geom::PrimitiveRecord& p = prims_[i];
+        const double* d = p.data;
+        const uint32_t mat_id = mat_base_ + p.mat_id;
+        switch (p.type) {
+            case geom::PrimitiveType::kSphere:
+                list.AddSphere(core::Point3(d[0], d[1], d[2]), d[3], mat_id);
+                break;
+            case geom::PrimitiveType::kXyRect:
+            case geom::PrimitiveType::kXzRect:
+            case geom::PrimitiveType::kYzRect:
+                list.AddRect(p.type, d[0], d[1], d[2], d[3], d[4], mat_id);
+                break;
+            case geom::PrimitiveType::kTriangle:
+                list.AddTriangle(vertices_[p.index[0]], vertices_[p.index[1]], vertices_[p.index[2]], mat_id);
+                break;
+        }
+    }
+}
+
+void BundleGeometry::BindMaterials(material::MaterialTable& table) {
+    const uint32_t tex_base = static_cast<uint32_t>(table.textures().size());
+    auto remap = [tex_base](uint32_t id) {
+        return id == material::kInvalidId ? id : tex_base + id;
+    };
+
+    const BundleTexture* textures = SectionData<BundleTexture>(header_->textures);
+    for (uint64_t i = 0; i < header_->textures.count; ++i) {
+        const BundleTexture& t = textures[i];
+        material::TextureRecord r;
+        r.type = t.type;
+        r.color = core::Color(t.color[0], t.color[1], t.color[2]);
+        r.inv_scale = t.inv_scale;
+        r.even = remap(t.even);
+        r.odd = remap(t.odd);
+        r.image = t.image < images_.size() ? images_[t.image].get() : nullptr;  // validated for kImage
+        table.AddTextureRecord(r);
+    }
+
+    mat_base_ = static_cast<uint32_t>(table.size());
+    const BundleMaterial* materials = SectionData<BundleMaterial>(header_->materials);
+    for (uint64_t i = 0; i < header_->materials.count; ++i) {
+        const BundleMaterial& m = materials[i];
+        material::MaterialRecord r;
+        r.type = m.type;
+        r.texture = remap(m.texture);
+        r.albedo = core::Color(m.albedo[0], m.albedo[1], m.albedo[2]);
+        r.fuzz = m.fuzz;
+        r.ior = m.ior;
+        table.AddRecord(r);
+    }
+}
+
+// ---------------- Writing ----------------
+
+class BundleWriter {
+public:
+    explicit BundleWriter(std::ofstream& out) : out_(out) {}
+
+    // appends count elements at the next aligned offset
+    template <class T>
+    Section Write(const T* data, size_t count) {
+        Pad();
+        Section s{ offset_, count };
+        if (count > 0) {
+            out_.write(reinterpret_cast<const char*>(data), std::streamsize(count * sizeof(T)));
+            offset_ += count * sizeof(T);
+        }
+        return s;
+    }
+
+    template <class T>
+    Section Write(const std::vector<T>& v) { return Write(v.data(), v.size()); }
+
+    void Skip(size_t bytes) {
+        std::vector<char> zeros(bytes, 0);
+        out_.write(zeros.data(), std::streamsize(bytes));
+        offset_ += bytes;
+    }
+
+private:
+    void Pad() {
+        if (offset_ % kSectionAlign)
+            Skip(kSectionAlign - offset_ % kSectionAlign);
+    }
+
+    std::ofstream& out_;
+    uint64_t offset_ = 0;
+};
+
+}  // namespace
+
+bool WriteSceneBundle(const std::string& path, const Scene& world) {
+    const material::MaterialTable& table = world.Materials();
+
+    geom::PrimitiveList list;
+    world.Record(list);
+    const auto& records = list.records();
+    const auto& vertices = list.vertices();
+    if (records.empty()) {
+        std::cerr << "ERROR: Scene has no primitives to write to bundle '" << path << "'\n";
+        return false;
+    }
+
+    // the same SAH build as the scene's own top level Bvh
+    std::vector<std::shared_ptr<geom::Hittable>> proxies;
+    proxies.reserve(records.size());
+    uint64_t triangles = 0;
+    for (const auto& r : records) {
+        proxies.push_back(std::make_shared<BoundsProxy>(RecordBounds(r, vertices.data())));
+        triangles += r.type == geom::PrimitiveType::kTriangle;
+    }
+    geom::Bvh bvh(proxies);
+
+    // images by path, relative to the bundle so the pair can be moved together
+    std::error_code ec;
+    const fs::path dir = fs::weakly_canonical(fs::absolute(path).parent_path(), ec);
+    std::vector<BundleImage> images;
+    std::string strings;
+    std::unordered_map<const Image*, uint32_t> image_ids;
+
+    std::vector<BundleTexture> textures;
+    for (const auto& t : table.textures()) {
+        BundleTexture bt{};
+        bt.type = t.type;
+        bt.even = t.even;
+        bt.odd = t.odd;
+        bt.image = material::kInvalidId;
+        bt.color[0] = t.color.x(); bt.color[1] = t.color.y(); bt.color[2] = t.color.z();
+        bt.inv_scale = t.inv_scale;
+
+        if (t.image) {
+            auto it = image_ids.find(t.image);
+            if (it == image_ids.end()) {
+                std::string file;
+                bool hdr = false;
+                if (!TextureCache::Global().Find(t.image, &file, &hdr)) {
+                    std::cerr << "ERROR: bundle: image texture was not loaded through the TextureCache\n";
+                    return false;
+                }
+                const fs::path source = fs::weakly_canonical(fs::absolute(Image::ResolvePath(file)), ec);
+                const fs::path rel = source.lexically_relative(dir);
+                const std::string stored = rel.empty() ? source.string() : rel.string();
+
+                BundleImage img{};
+                img.path_offset = uint32_t(strings.size());
+                img.path_length = uint32_t(stored.size());
+                img.hdr = hdr;
+                strings += stored;
+                it = image_ids.emplace(t.image, uint32_t(images.size())).first;
+                images.push_back(img);
+            }
+            bt.image = it->second;
+        }
+        textures.push_back(bt);
+    }
+
+    std::vector<BundleMaterial> materials;
+    for (const auto& m : table.materials()) {
+        BundleMaterial bm{};
+        bm.type = m.type;
+        bm.texture = m.texture;
+        bm.albedo[0] = m.albedo.x(); bm.albedo[1] = m.albedo.y(); bm.albedo[2] = m.albedo.z();
+        bm.fuzz = m.fuzz;
+        bm.ior = m.ior;
+        materials.push_back(bm);
+    }
+
+    // written under a temporary name so readers never see a partial file
+    const std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary);
+    if (!out) {
+        std::cerr << "ERROR: Could not write scene bundle '" << path << "'\n";
+        return false;
+    }
+
+    BundleHeader header{};
+    std::memcpy(header.magic, kBundleMagic, sizeof(kBundleMagic));
+    header.version = kBundleVersion;
+    header.record_size = sizeof(geom::PrimitiveRecord);
+    header.vertex_size = sizeof(core::Point3);
+    header.node_size = sizeof(geom::BvhNodeGPU);
+    header.root = bvh.root();
+    header.triangles = triangles;
+
+    BundleWriter writer(out);
+    writer.Skip(sizeof(BundleHeader));
+    header.materials    = writer.Write(materials);
+    header.textures     = writer.Write(textures);
+    header.images       = writer.Write(images);
+    header.strings      = writer.Write(strings.data(), strings.size());
+    header.primitives   = writer.Write(records);
+    header.vertices     = writer.Write(vertices);
+    header.nodes        = writer.Write(bvh.nodes());
+    header.prim_indices = writer.Write(bvh.prim_indices());
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        std::cerr << "ERROR: Could not write scene bundle '" << path << "'\n";
+        return false;
+    }
+    return true;
+}
+
+bool LoadSceneBundle(const std::string& path, Scene& world, SceneStats* stats) {
+    SceneStats local;
+    SceneStats& st = stats ? *stats : local;
+    st = SceneStats();
+
+    core::Timer clock;
+    auto bundle = std::make_shared<BundleGeometry>();
+    if (!bundle->Open(path))
+        return false;
+    st.parse_seconds = clock.elapsed();
+    st.primitives = bundle->Primitives();
+    st.triangles = bundle->Triangles();
+
+    clock.reset();
+    world.Clear();
+    world.Add(bundle);
+    world.BuildMaterialTable();
+    st.table_seconds = clock.elapsed();
+    st.materials = world.Materials().size();
+    return true;
+}
+
+}  // namespace rt::scene
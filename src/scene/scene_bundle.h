@@ -0,0 +1,35 @@
+#pragma once
+
+#include "scene/scene_loader.h"
+
+#include <string>
+
+namespace rt::scene {
+
+class Scene;
+
+// Binary scene bundles (.rtb).
+//
+// A bundle is a built scene written out in its in-memory layout: material and
+// texture records, primitive records, the vertex buffer, the flattened Bvh
+// nodes and primitive indices, each section 64 byte aligned. Loading maps the
+// file and renders straight from the mapping, so nothing is parsed, built or
+// copied besides the (small) material table and the texture images, which
+// are referenced by path.
+//
+// Instances are flattened to world space triangles. Bundles hold no Material
+// objects, so HitRecord::mat stays null; both renderers shade through the
+// MaterialTable and render a bundle like the scene it was written from.
+// Every id in the file is checked against its section on load, corrupt
+// bundles are rejected.
+//
+// Bundles are a cache of the machine that wrote them: the header records
+// the record layout and mismatching files are rejected.
+
+// world must have its MaterialTable built (LoadScene does)
+bool WriteSceneBundle(const std::string& path, const Scene& world);
+
+// replaces world's contents; LoadScene calls this for ".rtb" files
+bool LoadSceneBundle(const std::string& path, Scene& world, SceneStats* stats = nullptr);
+
+}  // namespace rt::scene
@@ -0,0 +1,477 @@
+#include "scene/scene_loader.h"
+
+#include "core/math_utils.h"
+#include "core/timer.h"
+#include "geom/bvh.h"
+#include "geom/instance.h"
+#include "geom/mesh.h"
+#include "geom/obj_loader.h"
+#include "geom/rect.h"
+#include "geom/sphere.h"
+#include "geom/triangle.h"
+#include "material/material.h"
+#include "material/texture.h"
+#include "scene/scene.h"
+#include "scene/scene_bundle.h"
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rt::scene {
+
+namespace {
+
+using json = nlohmann::json;
+using HittablePtr = std::shared_ptr<geom::Hittable>;
+using MaterialPtr = std::shared_ptr<material::Material>;
+using TexturePtr  = std::shared_ptr<material::Texture>;
+
+// Turns the parsed document into primitives. Named textures and materials
+// are created once, on first reference, so definition order does not matter;
+// declared meshes are all loaded up front, in parallel.
+class SceneBuilder {
+ public:
+    SceneBuilder(const json& doc, std::string dir)
+        : doc_(doc), dir_(std::move(dir)) {}
+
+    bool Build(std::vector<HittablePtr>& prims, SceneStats& stats);
+
+ private:
+    bool Fail(const std::string& msg) {
+        std::cerr << "ERROR: scene: " << msg << "\n";
+        ok_ = false;
+        return false;
+    }
+
+    // a relative path next to the scene file wins over the cwd / IMAGE_DIR
+    std::string Asset(const std::string& file) const {
+        std::filesystem::path p = std::filesystem::path(dir_) / file;
+        std::error_code ec;
+        if (!dir_.empty() && std::filesystem::path(file).is_relative() && std::filesystem::exists(p, ec))
+            return p.string();
+        return file;
+    }
+
+    // [x,y,z], a single number is splatted
+    core::Vec3 VecOf(const json& v, const std::string& what);
+    core::Vec3 Vec(const json& obj, const char* key, const core::Vec3& def);
+
+    // references are a name, a color [r,g,b] (textures) or an inline object
+    TexturePtr Texture(const json& ref);
+    MaterialPtr Material(const json& ref);
+    TexturePtr MakeTexture(const json& def);
+    MaterialPtr MakeMaterial(const json& def);
+
+    bool LoadMeshes(SceneStats& stats);
+    HittablePtr MeshBvh(const std::string& name, SceneStats& stats);
+
+    bool AddObject(const json& obj, const MaterialPtr& light, std::vector<HittablePtr>& prims, SceneStats& stats);
+    void AddSphereField(const json& obj, std::vector<HittablePtr>& prims);
+
+    const json& doc_;
+    std::string dir_;
+    bool ok_ = true;
+
+    std::unordered_map<std::string, TexturePtr> textures_;
+    std::unordered_map<std::string, MaterialPtr> materials_;
+    std::unordered_map<std::string, std::shared_ptr<geom::Mesh>> meshes_;
+    std::unordered_map<std::string, HittablePtr> mesh_bvhs_;
+    std::unordered_set<std::string> resolving_;  // reference cycle guard
+};
+
+core::Vec3 SceneBuilder::VecOf(const json& v, const std::string& what) {
+    if (v.is_number()) {
+        double s = v.get<double>();
+        return core::Vec3(s, s, s);
+    }
+    if (!v.is_array() || v.size() != 3) {
+        Fail("'" + what + "' must be [x,y,z]");
+        return core::Vec3(0,0,0);
+    }
+    return core::Vec3(v[0].get<double>(), v[1].get<double>(), v[2].get<double>());
+}
+
+core::Vec3 SceneBuilder::Vec(const json& obj, const char* key, const core::Vec3& def) {
+    if (!obj.contains(key)) return def;
+    return VecOf(obj[key], key);
+}
+
+// ---------------- Textures and materials ----------------
+
+TexturePtr SceneBuilder::Texture(const json& ref) {
+    if (ref.is_array() || ref.is_number())
+        return std::make_shared<material::SolidColor>(VecOf(ref, "color"));
+    if (ref.is_object())
+        return MakeTexture(ref);
+    if (!ref.is_string()) {
+        Fail("texture reference must be a name, [r,g,b] or an object");
+        return nullptr;
+    }
+
+    const std::string name = ref.get<std::string>();
+    auto it = textures_.find(name);
+    if (it != textures_.end()) return it->second;
+
+    if (!doc_.contains("textures") || !doc_["textures"].contains(name)) {
+        Fail("unknown texture '" + name + "'");
+        return nullptr;
+    }
+    if (!resolving_.insert("t:" + name).second) {
+        Fail("texture '" + name + "' references itself");
+        return nullptr;
+    }
+    TexturePtr tex = MakeTexture(doc_["textures"][name]);
+    resolving_.erase("t:" + name);
+    textures_.emplace(name, tex);
+    return tex;
+}
+
+TexturePtr SceneBuilder::MakeTexture(const json& def) {
+    const std::string type = def.value("type", "solid");
+
+    if (type == "solid")
+        return std::make_shared<material::SolidColor>(Vec(def, "color", core::Color(0,0,0)));
+
+    if (type == "checker") {
+        TexturePtr even = Texture(def.value("even", json::array({0.2, 0.3, 0.1})));
+        TexturePtr odd  = Texture(def.value("odd",  json::array({0.9, 0.9, 0.9})));
+        if (!even || !odd) return nullptr;
+        return std::make_shared<material::CheckerTexture>(def.value("scale", 1.0), even, odd);
+    }
+
+    if (type == "image") {
+        if (!def.contains("file")) {
+            Fail("image texture needs a 'file'");
+            return nullptr;
+        }
+        const std::string file = Asset(def["file"].get<std::string>());
+        return std::make_shared<material::ImageTexture>(file.c_str(), def.value("hdr", false));
+    }
+
+    Fail("unknown texture type '" + type + "'");
+    return nullptr;
+}
+
+MaterialPtr SceneBuilder::Material(const json& ref) {
+    if (ref.is_object())
+        return MakeMaterial(ref);
+    if (!ref.is_string()) {
+        Fail("material reference must be a name or an object");
+        return nullptr;
+    }
+
+    const std::string name = ref.get<std::string>();
+    auto it = materials_.find(name);
+    if (it != materials_.end()) return it->second;
+
+    if (!doc_.contains("materials") || !doc_["materials"].contains(name)) {
+        Fail("unknown material '" + name + "'");
+        return nullptr;
+    }
+    MaterialPtr mat = MakeMaterial(doc_["materials"][name]);
+    materials_.emplace(name, mat);
+    return mat;
+}
+
+MaterialPtr SceneBuilder::MakeMaterial(const json& def) {
+    const std::string type = def.value("type", "lambertian");
+
+    if (type == "lambertian") {
+        TexturePtr albedo = Texture(def.value("albedo", json::array({0.5, 0.5, 0.5})));
+        if (!albedo) return nullptr;
+        return std::make_shared<material::Lambertian>(albedo);
+    }
+
+    if (type == "metal")
+        return std::make_shared<material::Metal>(Vec(def, "albedo", core::Color(0.8, 0.8, 0.8)), def.value("fuzz", 0.0));
+
+    if (type == "dielectric")
+        return std::make_shared<material::Dielectric>(def.value("ior", 1.5));
+
+    if (type == "light") {
+        TexturePtr emit = Texture(def.value("emit", json::array({1.0, 1.0, 1.0})));
+        if (!emit) return nullptr;
+        return std::make_shared<material::DiffuseLight>(emit);
+    }
+
+    Fail("unknown material type '" + type + "'");
+    return nullptr;
+}
+
+// ---------------- Meshes ----------------
+
+// every declared mesh is read up front, files in parallel
+bool SceneBuilder::LoadMeshes(SceneStats& stats) {
+    if (!doc_.contains("meshes")) return true;
+
+    struct Job {
+        std::string name;
+        std::string file;
+        MaterialPtr mat;
+        double scale;
+        bool center;
+        std::shared_ptr<geom::Mesh> mesh;
+    };
+    std::vector<Job> jobs;
+
+    for (const auto& [name, def] : doc_["meshes"].items()) {
+        if (!def.contains("file") || !def.contains("material"))
+            return Fail("mesh '" + name + "' needs a 'file' and a 'material'");
+        MaterialPtr mat = Material(def["material"]);
+        if (!mat) return false;
+        jobs.push_back({ name, Asset(def["file"].get<std::string>()), mat,
+                         def.value("scale", 1.0), def.value("center", false), nullptr });
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < jobs.size(); ++i)
+        jobs[i].mesh = geom::LoadObj(jobs[i].file, jobs[i].mat, jobs[i].scale, jobs[i].center);
+
+    for (auto& job : jobs) {
+        if (!job.mesh) return Fail("could not load mesh '" + job.name + "'");
+        stats.triangles += job.mesh->tris.objects_.size();
+        meshes_.emplace(job.name, job.mesh);
+    }
+    return true;
+}
+
+HittablePtr SceneBuilder::MeshBvh(const std::string& name, SceneStats& stats) {
+    auto it = mesh_bvhs_.find(name);
+    if (it != mesh_bvhs_.end()) return it->second;
+
+    auto mesh = meshes_.find(name);
+    if (mesh == meshes_.end()) {
+        Fail("unknown mesh '" + name + "'");
+        return nullptr;
+    }
+
+    core::Timer clock;
+    HittablePtr bvh = std::make_shared<geom::Bvh>(*mesh->second);
+    stats.bvh_seconds += clock.elapsed();
+
+    mesh_bvhs_.emplace(name, bvh);
+    return bvh;
+}
+
+// ---------------- Objects ----------------
+
+bool SceneBuilder::AddObject(const json& obj, const MaterialPtr& light, std::vector<HittablePtr>& prims, SceneStats& stats) {
+    const std::string type = obj.value("type", "");
+
+    // geometry that takes a material
+    auto mat = [&]() -> MaterialPtr {
+        if (light) return light;
+        if (!obj.contains("material")) {
+            Fail("'" + type + "' needs a 'material'");
+            return nullptr;
+        }
+        return Material(obj["material"]);
+    };
+
+    if (type == "sphere") {
+        MaterialPtr m = mat();
+        if (!m) return false;
+        prims.push_back(std::make_shared<geom::Sphere>(Vec(obj, "center", core::Point3(0,0,0)), obj.value("radius", 1.0), m));
+        return ok_;
+    }
+
+    if (type == "xy_rect" || type == "xz_rect" || type == "yz_rect") {
+        MaterialPtr m = mat();
+        if (!m) return false;
+        const char* a = (type == "yz_rect") ? "y" : "x";
+        const char* b = (type == "xy_rect") ? "y" : "z";
+        const double a0 = obj.value(std::string(a) + "0", 0.0), a1 = obj.value(std::string(a) + "1", 1.0);
+        const double b0 = obj.value(std::string(b) + "0", 0.0), b1 = obj.value(std::string(b) + "1", 1.0);
+        const double k  = obj.value("k", 0.0);
+        if (type == "xy_rect")      prims.push_back(std::make_shared<geom::xy_rect>(a0, a1, b0, b1, k, m));
+        else if (type == "xz_rect") prims.push_back(std::make_shared<geom::xz_rect>(a0, a1, b0, b1, k, m));
+        else                        prims.push_back(std::make_shared<geom::yz_rect>(a0, a1, b0, b1, k, m));
+        return true;
+    }
+
+    if (type == "triangle") {
+        MaterialPtr m = mat();
+        if (!m) return false;
+        prims.push_back(std::make_shared<geom::Triangle>(
+            Vec(obj, "a", core::Point3(0,0,0)), Vec(obj, "b", core::Point3(1,0,0)), Vec(obj, "c", core::Point3(0,1,0)), m));
+        return ok_;
+    }
+
+    // a mesh placed as is goes into the top level Bvh triangle by triangle
+    if (type == "mesh") {
+        auto mesh = meshes_.find(obj.value("mesh", ""));
+        if (mesh == meshes_.end())
+            return Fail("unknown mesh '" + obj.value("mesh", "") + "'");
+        const auto& tris = mesh->second->tris.objects_;
+        prims.insert(prims.end(), tris.begin(), tris.end());
+        return true;
+    }
+
+    // scale, then rotate about x, y, z (degrees), then translate
+    if (type == "instance") {
+        HittablePtr object = MeshBvh(obj.value("mesh", ""), stats);
+        if (!object) return false;
+
+        const core::Vec3 rotate = Vec(obj, "rotate", core::Vec3(0,0,0));
+        geom::Transform xform = geom::Transform::Translate(Vec(obj, "translate", core::Vec3(0,0,0)))
+                              * geom::Transform::Rotate(2, rotate.z())
+                              * geom::Transform::Rotate(1, rotate.y())
+                              * geom::Transform::Rotate(0, rotate.x())
+                              * geom::Transform::Scale(Vec(obj, "scale", core::Vec3(1,1,1)));
+        if (std::fabs(xform.Determinant()) < 1e-12)
+            return Fail("instance transform is singular");
+
+        prims.push_back(std::make_shared<geom::Instance>(object, xform));
+        ++stats.instances;
+        return ok_;
+    }
+
+    if (type == "sphere_field") {
+        AddSphereField(obj, prims);
+        return ok_;
+    }
+
+    return Fail("unknown object type '" + type + "'");
+}
+
+// The random field of small spheres from the final scene of "Ray Tracing in
+// One Weekend": one sphere per grid cell in [-extent, extent)^2, 20% with
+// "texturedMaterial" (if given), 60% diffuse, 15% metal, 5% glass.
+void SceneBuilder::AddSphereField(const json& obj, std::vector<HittablePtr>& prims) {
+    const int extent = obj.value("extent", 11);
+    const double radius = obj.value("radius", 0.2);
+    const core::Point3 avoid = Vec(obj, "avoid", core::Point3(4, 0.2, 0));
+
+    MaterialPtr textured;
+    if (obj.contains("texturedMaterial")) {
+        textured = Material(obj["texturedMaterial"]);
+        if (!textured) return;
+    }
+    auto glass = std::make_shared<material::Dielectric>(1.5);
+
+    prims.reserve(prims.size() + size_t(2 * extent) * (2 * extent));
+    for (int a = -extent; a < extent; a++) {
+        for (int b = -extent; b < extent; b++) {
+            auto choose_mat = core::RandomDouble();
+            core::Point3 center(a + 0.9*core::RandomDouble(), radius, b + 0.9*core::RandomDouble());
+
+            if ((center - avoid).length() <= 0.9)
+                continue;
+
+            MaterialPtr sphere_material;
+            if (choose_mat < 0.2 && textured) {
+                sphere_material = textured;
+            } else if (choose_mat < 0.8) {
+                sphere_material = std::make_shared<material::Lambertian>(core::RandomVec3(0, 1));
+            } else if (choose_mat < 0.95) {
+                auto albedo = core::RandomVec3(0.5, 1);
+                auto fuzz = core::RandomDouble(0, 0.5);
+                sphere_material = std::make_shared<material::Metal>(albedo, fuzz);
+            } else {
+                sphere_material = glass;
+            }
+            prims.push_back(std::make_shared<geom::Sphere>(center, radius, sphere_material));
+        }
+    }
+}
+
+bool SceneBuilder::Build(std::vector<HittablePtr>& prims, SceneStats& stats) {
+    if (!LoadMeshes(stats)) return false;
+
+    if (doc_.contains("objects")) {
+        for (const auto& obj : doc_["objects"]) {
+            if (!AddObject(obj, nullptr, prims, stats)) return false;
+        }
+    }
+
+    // lights are plain geometry with an emissive material
+    if (doc_.contains("lights")) {
+        for (const auto& obj : doc_["lights"]) {
+            MaterialPtr light = MakeMaterial({ {"type", "light"}, {"emit", obj.value("emit", json::array({1.0, 1.0, 1.0}))} });
+            if (!light || !AddObject(obj, light, prims, stats)) return false;
+        }
+    }
+
+    return ok_;
+}
+
+}  // namespace
+
+bool LoadScene(const std::string& path, Scene& world, SceneStats* stats) {
+    const std::string ext = std::filesystem::path(path).extension().string();
+    if (ext == ".rtb")
+        return LoadSceneBundle(path, world, stats);
+
+    SceneStats local;
+    SceneStats& st = stats ? *stats : local;
+    st = SceneStats();
+
+    core::Timer clock;
+    json doc;
+    if (ext == ".obj") {
+        // a bare model is one white mesh
+        doc = {
+            {"meshes", {{"model", {
+                {"file", std::filesystem::path(path).filename().string()},
+                {"material", {{"type", "lambertian"}, {"albedo", {0.73, 0.73, 0.73}}}},
+            }}}},
+            {"objects", json::array({ {{"type", "mesh"}, {"mesh", "model"}} })},
+        };
+    } else {
+        std::ifstream f(path, std::ios::binary);
+        if (!f) {
+            std::cerr << "ERROR: Could not open scene '" << path << "'\n";
+            return false;
+        }
+        std::ostringstream text;
+        text << f.rdbuf();
+
+        doc = json::parse(text.str(), nullptr, false);
+        if (doc.is_discarded() || !doc.is_object()) {
+            std::cerr << "ERROR: Scene '" << path << "' is not a valid JSON object\n";
+            return false;
+        }
+    }
+    st.parse_seconds = clock.elapsed();
+
+    std::vector<HittablePtr> prims;
+    clock.reset();
+    try {
+        SceneBuilder builder(doc, std::filesystem::path(path).parent_path().string());
+        if (!builder.Build(prims, st)) return false;
+    } catch (const json::exception& e) {
+        // wrong value types surface as json exceptions
+        std::cerr << "ERROR: scene: " << e.what() << "\n";
+        return false;
+    }
+    st.build_seconds = clock.elapsed() - st.bvh_seconds;
+
+    if (prims.empty()) {
+        std::cerr << "ERROR: Scene '" << path << "' has no objects\n";
+        return false;
+    }
+    st.primitives = prims.size();
+
+    clock.reset();
+    world.Clear();
+    world.Add(std::make_shared<geom::Bvh>(prims));
+    st.bvh_seconds += clock.elapsed();
+
+    clock.reset();
+    world.BuildMaterialTable();
+    st.table_seconds = clock.elapsed();
+    st.materials = world.Materials().size();
+
+    return true;
+}
+
+}  // namespace rt::scene
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace rt::scene {
+
+class Scene;
+
+// what a scene load built and where its time went
+struct SceneStats {
+    double parse_seconds = 0.0;   // file read + json parse
+    double build_seconds = 0.0;   // textures, materials, primitives, meshes
+    double bvh_seconds   = 0.0;   // top level Bvh and instanced mesh Bvhs
+    double table_seconds = 0.0;   // MaterialTable
+
+    size_t primitives = 0;        // entries of the top level Bvh
+    size_t triangles  = 0;        // mesh triangles, counted once per mesh
+    size_t instances  = 0;
+    size_t materials  = 0;
+
+    double TotalSeconds() const {
+        return parse_seconds + build_seconds + bvh_seconds + table_seconds;
+    }
+};
+
+// Builds world from a JSON scene file.
+//
+// Top level keys, all optional:
+//   "textures":  { name: {"type": "solid"|"checker"|"image", ...} }
+//   "materials": { name: {"type": "lambertian"|"metal"|"dielectric"|"light", ...} }
+//   "meshes":    { name: {"file": "model.obj", "material": ..., "scale": s, "center": bool} }
+//   "objects":   [ {"type": "sphere"|"xy_rect"|"xz_rect"|"yz_rect"|"triangle"
+//                          |"mesh"|"instance"|"sphere_field", ...} ]
+//   "lights":    [ objects with "emit": [r,g,b] instead of a material ]
+//
+// Materials and textures are referenced by name or written inline; colors
+// are [r,g,b]. Relative file paths are looked up next to the scene file
+// first. Every primitive goes into one top level Bvh, mesh instances share
+// one Bvh per mesh, and the scene's MaterialTable is built before returning.
+//
+// ".rtb" scene bundles are mapped instead (see scene_bundle.h), and a bare
+// ".obj" file loads as a single white mesh.
+//
+// Returns false and reports to std::cerr on error.
+bool LoadScene(const std::string& path, Scene& world, SceneStats* stats = nullptr);
+
+}  // namespace rt::scene
@@ -0,0 +1,102 @@
+#include "scene/texture_cache.h"
+#include "scene/tile_cache.h"
+
+#include "core/timer.h"
+
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+namespace rt::scene {
+
+TextureCache& TextureCache::Global() {
+  static TextureCache cache;
+  return cache;
+}
+
+std::shared_ptr<const Image> TextureCache::Get(const std::string& path, bool hdr) {
+  const std::string key = hdr ? path + "#hdr" : path;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = images_.find(key);
+  if (it != images_.end())
+    return it->second;
+
+  std::shared_ptr<const Image> image = streaming_
+      ? LoadStreamed(path, hdr)
+      : std::make_shared<const Image>(path, hdr);
+  images_.emplace(key, image);
+  return image;
+}
+
+void TextureCache::EnableStreaming(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  streaming_ = budget_bytes > 0;
+  if (streaming_)
+    TileCache::Global().SetBudget(budget_bytes);
+}
+
+std::shared_ptr<const Image> TextureCache::LoadStreamed(const std::string& path, bool hdr) {
+  namespace fs = std::filesystem;
+
+  const std::string source = Image::ResolvePath(path);
+  const std::string tiled = source + (hdr ? ".hdr.tiles" : ".tiles");
+
+  // a tiled file without its source is used as is
+  std::error_code ec;
+  bool fresh = fs::exists(tiled, ec);
+  if (fresh && fs::exists(source, ec))
+    fresh = fs::last_write_time(tiled, ec) >= fs::last_write_time(source, ec);
+
+  if (!fresh) {
+    // one-time conversion, the decoded image is dropped afterwards
+    core::Timer clock;
+    auto resident = std::make_shared<Image>(path, hdr);
+    if (resident->Levels() == 0 || !resident->WriteTiled(tiled)) {
+      std::cerr << "WARNING: Could not write tiled texture '" << tiled
+                << "', keeping '" << path << "' in memory\n";
+      return resident;
+    }
+    std::clog << "Converted " << path << " to tiles in "
+              << std::setprecision(2) << clock.elapsed() << "s\n";
+  }
+
+  auto streamed = std::make_shared<Image>();
+  if (!streamed->OpenTiled(tiled)) {
+    std::cerr << "ERROR: Could not open tiled texture '" << tiled << "'\n";
+    return std::make_shared<const Image>(path, hdr);
+  }
+  return streamed;
+}
+
+bool TextureCache::Find(const Image* image, std::string* path, bool* hdr) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& [key, cached] : images_) {
+    if (cached.get() != image) continue;
+    const bool is_hdr = key.size() > 4 && key.compare(key.size() - 4, 4, "#hdr") == 0;
+    if (path) *path = is_hdr ? key.substr(0, key.size() - 4) : key;
+    if (hdr) *hdr = is_hdr;
+    return true;
+  }
+  return false;
+}
+
+size_t TextureCache::Count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return images_.size();
+}
+
+size_t TextureCache::MemoryBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t bytes = 0;
+  for (const auto& [key, image] : images_)
+    bytes += image->MemoryBytes();
+  return bytes;
+}
+
+void TextureCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  images_.clear();
+}
+
+}  // namespace rt::scene
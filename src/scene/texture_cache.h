@@ -0,0 +1,48 @@
+#pragma once
+#include "scene/image.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace rt::scene {
+
+// Process-wide store of loaded texture images.
+// Images are deduplicated by path (and format), so every ImageTexture that
+// names the same file shares one read-only copy.
+class TextureCache {
+ public:
+  static TextureCache& Global();
+
+  // loads the image on first use; failed loads are cached too so the error
+  // is only reported once
+  std::shared_ptr<const Image> Get(const std::string& path, bool hdr = false);
+
+  // Out-of-core mode for images loaded from now on: each file is converted
+  // once to a tiled file next to it ("<file>.tiles", redone when the source
+  // is newer) and its tiles are paged in through the TileCache, which is
+  // limited to budget_bytes. 0 turns streaming off.
+  void EnableStreaming(size_t budget_bytes);
+  bool Streaming() const { return streaming_; }
+
+  // path and format an image was loaded with, false if it is not cached
+  bool Find(const Image* image, std::string* path, bool* hdr) const;
+
+  size_t Count() const;
+  size_t MemoryBytes() const;
+
+  // drops the cache's references, images still used by textures stay alive
+  void Clear();
+
+ private:
+  std::shared_ptr<const Image> LoadStreamed(const std::string& path, bool hdr);
+
+  bool streaming_ = false;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<const Image>> images_;
+};
+
+}  // namespace rt::scene
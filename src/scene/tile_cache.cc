@@ -0,0 +1,61 @@
+#include "scene/tile_cache.h"
+
+#include "core/random.h"
+
+namespace rt::scene {
+
+TileCache& TileCache::Global() {
+  static TileCache cache;
+  return cache;
+}
+
+void TileCache::SetBudget(size_t bytes) {
+  budget_ = bytes;
+}
+
+std::shared_ptr<const TileCache::Tile> TileCache::Fetch(
+    uint64_t key, const std::function<bool(Tile&)>& load) {
+  Shard& shard = shards_[core::Mix64(key) % kShards];
+
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+      ++hits_;
+      return it->second->second;
+    }
+  }
+
+  // read outside the lock, a racing load of the same tile is harmless
+  ++misses_;
+  auto tile = std::make_shared<Tile>();
+  if (!load(*tile)) return nullptr;
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) return it->second->second;
+
+  shard.lru.emplace_front(key, tile);
+  shard.index.emplace(key, shard.lru.begin());
+  shard.bytes += tile->size();
+  resident_ += tile->size();
+
+  // keep at least the new tile, even if it alone exceeds the share
+  const size_t share = budget_ / kShards;
+  while (shard.bytes > share && shard.lru.size() > 1) {
+    auto& victim = shard.lru.back();
+    shard.bytes -= victim.second->size();
+    resident_ -= victim.second->size();
+    shard.index.erase(victim.first);
+    shard.lru.pop_back();
+  }
+
+  size_t resident = resident_;
+  size_t peak = peak_;
+  while (resident > peak && !peak_.compare_exchange_weak(peak, resident)) {}
+
+  return tile;
+}
+
+}  // namespace rt::scene
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rt::scene {
+
+// Fixed-budget LRU cache of texture tiles, shared by all threads.
+// Keys are opaque 64 bit ids (image, level, tile). The cache is split into
+// shards with their own lock so concurrent lookups rarely contend; a tile
+// handed out stays valid for its holder even after it is evicted.
+class TileCache {
+ public:
+  using Tile = std::vector<unsigned char>;
+
+  static TileCache& Global();
+
+  void SetBudget(size_t bytes);
+  size_t Budget() const { return budget_; }
+
+  // returns the cached tile for key; on a miss load() fills a new tile
+  // (outside the shard lock) and the least recently used tiles are evicted
+  // until the shard fits its share of the budget
+  std::shared_ptr<const Tile> Fetch(uint64_t key, const std::function<bool(Tile&)>& load);
+
+  // unique id for every image that streams through the cache
+  uint32_t NewImageId() { return next_image_id_++; }
+
+  uint64_t Hits() const { return hits_; }
+  uint64_t Misses() const { return misses_; }
+  size_t ResidentBytes() const { return resident_; }
+  size_t PeakBytes() const { return peak_; }
+
+ private:
+  static constexpr int kShards = 16;
+
+  struct Shard {
+    std::mutex mutex;
+    std::list<std::pair<uint64_t, std::shared_ptr<const Tile>>> lru;  // front = newest
+    std::unordered_map<uint64_t, decltype(lru)::iterator> index;
+    size_t bytes = 0;
+  };
+
+  Shard shards_[kShards];
+  size_t budget_ = size_t(256) << 20;
+
+  std::atomic<uint32_t> next_image_id_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<size_t> resident_{0};
+  std::atomic<size_t> peak_{0};
+};
+
+}  // namespace rt::scene
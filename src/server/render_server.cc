@@ -0,0 +1,454 @@
+#include "server/render_server.h"
+
+#include "core/timer.h"
+#include "integrator/cpu_ray_integrator.h"
+#include "renderer/wavefront.h"
+#include "scene/camera.h"
+#include "scene/image_writer.h"
+#include "scene/scene.h"
+#include "scene/scene_loader.h"
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace rt::server {
+
+namespace {
+
+using json = nlohmann::json;
+
+constexpr size_t kMaxRequestBytes = 64 * 1024;
+
+// ---------------- Socket helpers ----------------
+
+// reads up to the first newline (or EOF), false on error or oversized input
+bool ReadLine(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (line.size() < kMaxRequestBytes) {
+        ssize_t n = recv(fd, &c, 1, 0);
+        if (n < 0) return false;
+        if (n == 0 || c == '\n') return !line.empty();
+        line.push_back(c);
+    }
+    return false;
+}
+
+// a client that went away must not take the server down (no SIGPIPE)
+bool SendLine(int fd, const std::string& line) {
+    std::string data = line + "\n";
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        left -= size_t(n);
+    }
+    return true;
+}
+
+bool SocketAddress(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "ERROR: Invalid socket path '" << path << "'\n";
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// ---------------- Jobs ----------------
+
+struct Job {
+    uint64_t id = 0;
+    int      priority = 0;
+    json     request;
+    int      fd = -1;  // the client connection, closed when the job ends
+
+    void Send(json event) const {
+        event["job"] = id;
+        SendLine(fd, event.dump());
+    }
+};
+
+// higher priority first, then arrival order
+struct JobOrder {
+    bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const {
+        if (a->priority != b->priority) return a->priority < b->priority;
+        return a->id > b->id;
+    }
+};
+
+// Loaded scenes by path, least recently used last.
+class SceneCache {
+public:
+    explicit SceneCache(size_t capacity) : capacity_(capacity) {}
+
+    // cached is set when no load was needed
+    std::shared_ptr<scene::Scene> Get(const std::string& path, bool& cached, scene::SceneStats& stats) {
+        std::error_code ec;
+        const auto stamp = std::filesystem::last_write_time(path, ec);
+
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->path != path) continue;
+            if (!ec && it->stamp != stamp) {
+                // changed on disk, load it again
+                entries_.erase(it);
+                break;
+            }
+            entries_.splice(entries_.begin(), entries_, it);
+            cached = true;
+            return entries_.front().world;
+        }
+
+        cached = false;
+        auto world = std::make_shared<scene::Scene>();
+        if (!scene::LoadScene(path, *world, &stats))
+            return nullptr;
+
+        entries_.push_front({ path, stamp, world });
+        while (entries_.size() > std::max<size_t>(capacity_, 1))
+            entries_.pop_back();  // jobs still rendering it hold a reference
+        return world;
+    }
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        std::string path;
+        std::filesystem::file_time_type stamp;
+        std::shared_ptr<scene::Scene> world;
+    };
+
+    size_t capacity_;
+    std::list<Entry> entries_;
+};
+
+class RenderServer {
+public:
+    explicit RenderServer(const ServerOptions& options)
+        : options_(options), scenes_(options.max_scenes) {}
+
+    bool Run();
+
+private:
+    void Serve(int fd);        // one connection, on its own thread
+    void HandleRequest(int fd);
+    void WorkLoop();           // the render thread
+    void RunJob(const Job& job);
+    void Stop();
+
+    ServerOptions options_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stop_{ false };
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, JobOrder> queue_;
+    uint64_t next_id_ = 1;
+    uint64_t running_ = 0;     // id of the job being rendered, 0 when idle
+    uint64_t finished_ = 0;
+
+    // connection threads still running and the fds they are still reading
+    // a request from; Run() waits for the threads, Stop() ends the reads
+    int connections_ = 0;
+    std::unordered_set<int> reading_;
+    std::condition_variable idle_;
+
+    SceneCache scenes_;        // render thread only
+};
+
+bool RenderServer::Run() {
+    sockaddr_un addr;
+    if (!SocketAddress(options_.socket_path, addr))
+        return false;
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "ERROR: Could not create socket\n";
+        return false;
+    }
+    // a socket file left behind by an earlier server
+    unlink(options_.socket_path.c_str());
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd_, 16) != 0) {
+        std::cerr << "ERROR: Could not listen on '" << options_.socket_path << "': " << std::strerror(errno) << "\n";
+        close(listen_fd_);
+        return false;
+    }
+    std::clog << "Render server listening on " << options_.socket_path << "\n";
+
+    std::thread worker(&RenderServer::WorkLoop, this);
+
+    while (!stop_) {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (stop_) break;
+            if (errno == EINTR) continue;
+            std::cerr << "ERROR: accept: " << std::strerror(errno) << "\n";
+            break;
+        }
+        // requests are read off the accept loop so a slow client blocks nobody
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++connections_;
+            reading_.insert(fd);
+        }
+        std::thread(&RenderServer::Serve, this, fd).detach();
+    }
+
+    Stop();
+    worker.join();
+    {
+        // connection threads use this server until they return
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return connections_ == 0; });
+    }
+    close(listen_fd_);
+    unlink(options_.socket_path.c_str());
+    std::clog << "Render server stopped after " << finished_ << " jobs\n";
+    return true;
+}
+
+void RenderServer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        // clients that have not sent their request yet see end of input
+        for (int fd : reading_)
+            shutdown(fd, SHUT_RD);
+    }
+    wake_.notify_all();
+    // unblocks accept()
+    shutdown(listen_fd_, SHUT_RDWR);
+}
+
+void RenderServer::Serve(int fd) {
+    HandleRequest(fd);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    --connections_;
+    idle_.notify_all();
+}
+
+void RenderServer::HandleRequest(int fd) {
+    std::string line;
+    json request;
+    const bool read = ReadLine(fd, line);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reading_.erase(fd);
+    }
+    if (!read || (request = json::parse(line, nullptr, false)).is_discarded() || !request.is_object()) {
+        SendLine(fd, json{ {"event", "error"}, {"message", "expected one JSON object per line"} }.dump());
+        close(fd);
+        return;
+    }
+
+    // fields of the wrong type are the client's error, as in RunJob
+    std::string command;
+    int priority = 0;
+    try {
+        command = request.value("command", "render");
+        priority = request.value("priority", 0);
+    } catch (const json::exception& e) {
+        SendLine(fd, json{ {"event", "error"}, {"message", e.what()} }.dump());
+        close(fd);
+        return;
+    }
+    if (command == "status") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SendLine(fd, json{ {"event", "status"}, {"queued", queue_.size()}, {"running", running_},
+                           {"finished", finished_} }.dump());
+        close(fd);
+        return;
+    }
+    if (command == "shutdown") {
+        SendLine(fd, json{ {"event", "shutdown"} }.dump());
+        close(fd);
+        Stop();
+        return;
+    }
+    if (command != "render" || !request.contains("output") || !request["output"].is_string()) {
+        SendLine(fd, json{ {"event", "error"}, {"message", "a render job needs an 'output' path"} }.dump());
+        close(fd);
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->request = request;
+    job->priority = priority;
+    job->fd = fd;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            SendLine(fd, json{ {"event", "error"}, {"message", "server is shutting down"} }.dump());
+            close(fd);
+            return;
+        }
+        job->id = next_id_++;
+        job->Send({ {"event", "queued"}, {"ahead", queue_.size() + (running_ ? 1 : 0)} });
+        queue_.push(job);
+    }
+    wake_.notify_one();
+}
+
+void RenderServer::WorkLoop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_) break;
+            job = queue_.top();
+            queue_.pop();
+            running_ = job->id;
+        }
+
+        RunJob(*job);
+        close(job->fd);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = 0;
+        ++finished_;
+    }
+
+    // jobs still waiting are told instead of dropped silently
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!queue_.empty()) {
+        queue_.top()->Send({ {"event", "error"}, {"message", "server shut down"} });
+        close(queue_.top()->fd);
+        queue_.pop();
+    }
+}
+
+void RenderServer::RunJob(const Job& job) {
+    auto fail = [&](const std::string& message) {
+        std::cerr << "ERROR: job " << job.id << ": " << message << "\n";
+        job.Send({ {"event", "error"}, {"message", message} });
+    };
+
+    core::Timer setup_clock;
+    const json& req = job.request;
+    std::string scene_path, camera_name, output;
+    int spp = 0;
+    try {
+        scene_path = req.value("scene", "scenes/cornell.json");
+        camera_name = req.value("camera", "default");
+        output = req.at("output").get<std::string>();
+        spp = req.value("spp", 0);
+    } catch (const json::exception& e) {
+        return fail(e.what());
+    }
+    scene::ImageFormat format;
+    if (!scene::FormatFromPath(output, format))
+        return fail("unknown image format of '" + output + "'");
+
+    // cameras.json is small, rereading it picks up edits between jobs
+    std::unordered_map<std::string, scene::CameraConfig> cameras;
+    try {
+        cameras = scene::loadCameras(options_.cameras_path);
+    } catch (const std::exception& e) {
+        return fail("could not read '" + options_.cameras_path + "': " + e.what());
+    }
+    if (!cameras.count(camera_name))
+        return fail("camera '" + camera_name + "' not found");
+
+    bool cached = false;
+    scene::SceneStats stats;
+    std::shared_ptr<scene::Scene> world = scenes_.Get(scene_path, cached, stats);
+    if (!world)
+        return fail("could not load scene '" + scene_path + "'");
+
+    scene::ColorCamera cam;
+    cam.SetFromConfig(cameras[camera_name]);
+    if (spp > 0)
+        cam.samples_per_pixel_ = spp;
+    cam.Initialize();
+
+    integrator::CPURayIntegrator integrator(world.get());
+    renderer::WavefrontRenderer renderer(*world, cam, integrator, cam.max_depth_, cam.samples_per_pixel_, 2 * 8192);
+    renderer.SetProgress([&job](int done, int total) {
+        job.Send({ {"event", "progress"}, {"pass", done}, {"passes", total} });
+    });
+
+    const double setup_seconds = setup_clock.elapsed();
+    job.Send({ {"event", "started"}, {"scene_cached", cached}, {"setup_seconds", setup_seconds} });
+    std::clog << "Job " << job.id << ": " << scene_path << " / " << camera_name << " -> " << output
+              << (cached ? " (cached scene)" : "") << ", setup " << std::setprecision(3) << setup_seconds << "s\n";
+
+    core::Timer render_clock;
+    renderer.Render();
+    const double render_seconds = render_clock.elapsed();
+
+    core::Timer write_clock;
+    if (!scene::WriteImage(output, renderer.Framebuffer(), cam.get_image_width(), cam.get_image_height()))
+        return fail("could not write '" + output + "'");
+
+    job.Send({ {"event", "done"}, {"output", output}, {"render_seconds", render_seconds},
+               {"write_seconds", write_clock.elapsed()} });
+    std::clog << "Job " << job.id << ": render " << std::setprecision(3) << render_seconds << "s\n";
+}
+
+}  // namespace
+
+bool RunRenderServer(const ServerOptions& options) {
+    RenderServer server(options);
+    return server.Run();
+}
+
+int SubmitRequest(const std::string& socket_path, const std::string& request, std::ostream& out) {
+    sockaddr_un addr;
+    if (!SocketAddress(socket_path, addr))
+        return 1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "ERROR: Could not connect to '" << socket_path << "'\n";
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    // the request must stay on one line
+    std::string line = request;
+    for (char& c : line) {
+        if (c == '\n' || c == '\r') c = ' ';
+    }
+    if (!SendLine(fd, line)) {
+        close(fd);
+        return 1;
+    }
+
+    std::string event, last;
+    while (ReadLine(fd, event)) {
+        out << event << std::endl;
+        last = event;
+    }
+    close(fd);
+
+    json reply = json::parse(last, nullptr, false);
+    if (reply.is_discarded()) return 1;
+    return reply.value("event", "") == "error" ? 1 : 0;
+}
+
+}  // namespace rt::server
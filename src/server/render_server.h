@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace rt::server {
+
+struct ServerOptions {
+    std::string socket_path;
+    std::string cameras_path = "cameras.json";  // reread for every job
+    size_t      max_scenes = 4;                 // loaded scenes kept in memory
+};
+
+// Long-running render server on a Unix domain socket.
+//
+// Every connection sends one JSON request on a single line:
+//
+//   {"scene": "scenes/cornell.json", "camera": "cornell", "spp": 64,
+//    "output": "out.png", "priority": 0}
+//   {"command": "status"}
+//   {"command": "shutdown"}
+//
+// and gets newline separated JSON events back until its job is finished:
+// "queued", "started" (with setup time and whether the scene was cached),
+// "progress" after every sample pass, then "done" or "error".
+//
+// Jobs run one at a time, each on all cores, highest priority first and in
+// arrival order within a priority. Loaded scenes stay cached (reloaded when
+// the file changes, least recently used dropped beyond max_scenes), so warm
+// jobs start rendering immediately.
+//
+// Returns false if the socket cannot be opened, true after a shutdown.
+bool RunRenderServer(const ServerOptions& options);
+
+// Client side: sends one request line and copies the replies to out.
+// Returns 0 when the last event is "done" (or a command was answered).
+int SubmitRequest(const std::string& socket_path, const std::string& request, std::ostream& out);
+
+}  // namespace rt::server
@@ -0,0 +1,461 @@
+#include "server/tile_cluster.h"
+
+#include "core/timer.h"
+#include "integrator/cpu_ray_integrator.h"
+#include "integrator/pixel_state.h"
+#include "renderer/wavefront.h"
+#include "scene/image_writer.h"
+#include "scene/scene.h"
+#include "scene/scene_loader.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace rt::server {
+
+namespace {
+
+using json = nlohmann::json;
+
+// ---------------- Wire format ----------------
+
+enum class MessageType : uint32_t {
+    kJob = 1,   // coordinator -> worker: scene and camera, JSON
+    kReady,     // worker -> coordinator: scene loaded, send work
+    kFailed,    // worker -> coordinator: could not set up, text
+    kUnit,      // coordinator -> worker: WireUnit
+    kResult,    // worker -> coordinator: WireUnit + WirePixel per tile pixel
+    kDone,      // coordinator -> worker: no work left
+};
+
+struct MessageHeader {
+    uint32_t type;
+    uint32_t size;  // payload bytes
+};
+
+constexpr uint32_t kMaxMessageBytes = 256u << 20;
+
+struct WireUnit {
+    uint32_t id;
+    int32_t  x0, y0, x1, y1;
+    int32_t  sample_begin, sample_end;
+    uint32_t pad;
+};
+
+struct WirePixel {
+    double   sum[3];
+    double   mean[3];
+    double   m2[3];
+    uint32_t samples;
+    uint32_t converged;
+};
+
+bool SendAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+bool RecvAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n <= 0) return false;
+        p += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+bool SendMessage(int fd, MessageType type, const void* payload = nullptr, size_t size = 0) {
+    MessageHeader header{ uint32_t(type), uint32_t(size) };
+    return SendAll(fd, &header, sizeof(header)) && (size == 0 || SendAll(fd, payload, size));
+}
+
+bool RecvMessage(int fd, MessageType& type, std::vector<char>& payload) {
+    MessageHeader header;
+    if (!RecvAll(fd, &header, sizeof(header)) || header.size > kMaxMessageBytes)
+        return false;
+    type = MessageType(header.type);
+    payload.resize(header.size);
+    return header.size == 0 || RecvAll(fd, payload.data(), header.size);
+}
+
+// ---------------- Coordinator ----------------
+
+struct Unit {
+    WireUnit wire;
+    bool done = false;
+};
+
+class Coordinator {
+public:
+    explicit Coordinator(const CoordinatorOptions& options);
+
+    bool Run();
+
+private:
+    void AcceptLoop();
+    void Serve(int fd, int worker);
+
+    // blocks until a unit is free; -1 once everything is merged
+    int NextUnit();
+    void Requeue(int unit);
+    bool Merge(int unit, const std::vector<char>& payload);
+
+    CoordinatorOptions options_;
+    int width_ = 0;
+    int height_ = 0;
+    std::string job_;   // kJob payload
+
+    int listen_fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<Unit> units_;
+    std::deque<int> pending_;
+    size_t merged_ = 0;
+    std::vector<integrator::PixelState> image_;
+    std::vector<std::thread> workers_;
+};
+
+Coordinator::Coordinator(const CoordinatorOptions& options) : options_(options) {
+    scene::ColorCamera cam;
+    cam.SetFromConfig(options_.camera);
+    cam.Initialize();
+    width_ = cam.get_image_width();
+    height_ = cam.get_image_height();
+    image_.assign(size_t(width_) * height_, integrator::PixelState{});
+
+    job_ = json{ {"scene", options_.scene_path}, {"camera", scene::cameraToJson(options_.camera)} }.dump();
+
+    // tiles in scanline order, each split into sample ranges
+    const int tile = std::max(options_.tile_size, 1);
+    const int spp = options_.camera.samples_per_pixel;
+    const int splits = std::clamp(options_.sample_splits, 1, std::max(spp, 1));
+    for (int y = 0; y < height_; y += tile) {
+        for (int x = 0; x < width_; x += tile) {
+            for (int k = 0; k < splits; ++k) {
+                Unit u;
+                u.wire = WireUnit{ uint32_t(units_.size()), x, y, std::min(x + tile, width_), std::min(y + tile, height_),
+                                   spp * k / splits, spp * (k + 1) / splits, 0 };
+                pending_.push_back(int(units_.size()));
+                units_.push_back(u);
+            }
+        }
+    }
+}
+
+bool Coordinator::Run() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(uint16_t(options_.port));
+    if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd_, 64) != 0) {
+        std::cerr << "ERROR: Could not listen on port " << options_.port << ": " << std::strerror(errno) << "\n";
+        if (listen_fd_ >= 0) close(listen_fd_);
+        return false;
+    }
+    std::clog << "Coordinator: " << width_ << "x" << height_ << ", " << units_.size()
+              << " work units, waiting for workers on port " << options_.port << "\n";
+
+    core::Timer clock;
+    std::thread acceptor(&Coordinator::AcceptLoop, this);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return merged_ == units_.size(); });
+    }
+    const double render_seconds = clock.elapsed();
+
+    // unblocks accept(); idle workers are told to stop by NextUnit
+    shutdown(listen_fd_, SHUT_RDWR);
+    acceptor.join();
+    close(listen_fd_);
+
+    std::vector<core::Color> framebuffer(image_.size(), core::Color(0,0,0));
+    for (size_t i = 0; i < image_.size(); ++i) {
+        if (image_[i].samples > 0)
+            framebuffer[i] = image_[i].sum / (float)image_[i].samples;
+    }
+    std::clog << "Coordinator: frame done in " << std::setprecision(3) << render_seconds << "s\n";
+
+    if (!scene::WriteImage(options_.output, framebuffer, width_, height_)) {
+        std::cerr << "ERROR: Failed to write image '" << options_.output << "'\n";
+        return false;
+    }
+    return true;
+}
+
+void Coordinator::AcceptLoop() {
+    int worker = 0;
+    while (true) {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;  // shut down
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        workers_.emplace_back(&Coordinator::Serve, this, fd, ++worker);
+    }
+    for (auto& t : workers_)
+        t.join();
+}
+
+void Coordinator::Serve(int fd, int worker) {
+    MessageType type = MessageType::kDone;
+    std::vector<char> payload;
+    const bool answered = SendMessage(fd, MessageType::kJob, job_.data(), job_.size()) && RecvMessage(fd, type, payload);
+    if (!answered || type != MessageType::kReady) {
+        if (answered && type == MessageType::kFailed)
+            std::cerr << "ERROR: worker " << worker << ": " << std::string(payload.begin(), payload.end()) << "\n";
+        close(fd);
+        return;
+    }
+    std::clog << "Coordinator: worker " << worker << " joined\n";
+
+    int units = 0;
+    while (true) {
+        const int unit = NextUnit();
+        if (unit < 0) {
+            SendMessage(fd, MessageType::kDone);
+            break;
+        }
+
+        const WireUnit& wire = units_[unit].wire;
+        if (!SendMessage(fd, MessageType::kUnit, &wire, sizeof(wire)) || !RecvMessage(fd, type, payload) ||
+            type != MessageType::kResult || !Merge(unit, payload)) {
+            std::cerr << "WARNING: worker " << worker << " dropped out, unit " << unit << " is handed out again\n";
+            Requeue(unit);
+            break;
+        }
+        ++units;
+    }
+    close(fd);
+    std::clog << "Coordinator: worker " << worker << " rendered " << units << " units\n";
+}
+
+int Coordinator::NextUnit() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // units in flight may still come back if their worker fails
+    changed_.wait(lock, [this] { return !pending_.empty() || merged_ == units_.size(); });
+    if (pending_.empty())
+        return -1;
+    int unit = pending_.front();
+    pending_.pop_front();
+    return unit;
+}
+
+void Coordinator::Requeue(int unit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_front(unit);
+    }
+    changed_.notify_all();
+}
+
+bool Coordinator::Merge(int unit, const std::vector<char>& payload) {
+    const WireUnit& wire = units_[unit].wire;
+    const size_t tile_w = size_t(wire.x1 - wire.x0);
+    const size_t count = tile_w * size_t(wire.y1 - wire.y0);
+    if (payload.size() != sizeof(WireUnit) + count * sizeof(WirePixel))
+        return false;
+
+    WireUnit echo;
+    std::memcpy(&echo, payload.data(), sizeof(echo));
+    if (echo.id != wire.id)
+        return false;
+    const WirePixel* pixels = reinterpret_cast<const WirePixel*>(payload.data() + sizeof(WireUnit));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (units_[unit].done)
+            return true;
+        for (size_t i = 0; i < count; ++i) {
+            const WirePixel& w = pixels[i];
+            integrator::PixelState ps;
+            ps.sum = core::Color(w.sum[0], w.sum[1], w.sum[2]);
+            ps.mean = core::Color(w.mean[0], w.mean[1], w.mean[2]);
+            ps.m2 = core::Color(w.m2[0], w.m2[1], w.m2[2]);
+            ps.samples = int(w.samples);
+            ps.converged = w.converged != 0;
+
+            const size_t x = wire.x0 + i % tile_w;
+            const size_t y = wire.y0 + i / tile_w;
+            integrator::MergePixel(image_[y * width_ + x], ps);
+        }
+        units_[unit].done = true;
+        ++merged_;
+        if (merged_ % 16 == 0 || merged_ == units_.size())
+            std::clog << "Coordinator: " << merged_ << "/" << units_.size() << " units\n";
+    }
+    changed_.notify_all();
+    return true;
+}
+
+// ---------------- Worker ----------------
+
+int Connect(const std::string& address) {
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        std::cerr << "ERROR: Worker address must be host:port, got '" << address << "'\n";
+        return -1;
+    }
+    const std::string host = address.substr(0, colon);
+    const std::string port = address.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) {
+        std::cerr << "ERROR: Could not resolve '" << address << "'\n";
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* a = found; a; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    if (fd < 0) {
+        std::cerr << "ERROR: Could not connect to '" << address << "'\n";
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    return fd;
+}
+
+}  // namespace
+
+bool RunCoordinator(const CoordinatorOptions& options) {
+    Coordinator coordinator(options);
+    return coordinator.Run();
+}
+
+bool RunWorker(const std::string& address) {
+    int fd = Connect(address);
+    if (fd < 0) return false;
+
+    MessageType type;
+    std::vector<char> payload;
+    if (!RecvMessage(fd, type, payload) || type != MessageType::kJob) {
+        std::cerr << "ERROR: No job from coordinator\n";
+        close(fd);
+        return false;
+    }
+
+    auto fail = [fd](const std::string& message) {
+        std::cerr << "ERROR: " << message << "\n";
+        SendMessage(fd, MessageType::kFailed, message.data(), message.size());
+        close(fd);
+        return false;
+    };
+
+    // the scene and camera are set up once for every unit of the frame
+    json job = json::parse(payload.begin(), payload.end(), nullptr, false);
+    if (job.is_discarded() || !job.contains("camera"))
+        return fail("malformed job");
+
+    scene::Scene world;
+    scene::SceneStats stats;
+    const std::string scene_path = job.value("scene", "scenes/cornell.json");
+    if (!scene::LoadScene(scene_path, world, &stats))
+        return fail("could not load scene '" + scene_path + "'");
+    std::clog << "Worker: " << scene_path << " loaded in " << std::setprecision(3) << stats.TotalSeconds() << "s\n";
+
+    scene::ColorCamera cam;
+    try {
+        cam.SetFromConfig(scene::parseCamera(job["camera"]));
+    } catch (const std::exception& e) {
+        return fail(std::string("bad camera: ") + e.what());
+    }
+    cam.Initialize();
+
+    integrator::CPURayIntegrator integrator(&world);
+    renderer::WavefrontRenderer renderer(world, cam, integrator, cam.max_depth_, cam.samples_per_pixel_, 2 * 8192);
+    const int width = cam.get_image_width();
+    const int height = cam.get_image_height();
+
+    if (!SendMessage(fd, MessageType::kReady)) {
+        close(fd);
+        return false;
+    }
+
+    int units = 0;
+    core::Timer clock;
+    std::vector<char> result;
+    while (RecvMessage(fd, type, payload) && type == MessageType::kUnit && payload.size() == sizeof(WireUnit)) {
+        WireUnit unit;
+        std::memcpy(&unit, payload.data(), sizeof(unit));
+
+        // the result is packed from these bounds, so they must lie in the image
+        if (unit.x0 < 0 || unit.y0 < 0 || unit.x0 >= unit.x1 || unit.y0 >= unit.y1 ||
+            unit.x1 > width || unit.y1 > height)
+            return fail("unit outside the image");
+
+        renderer.SetRegion(unit.x0, unit.y0, unit.x1, unit.y1);
+        renderer.SetSampleRange(unit.sample_begin, unit.sample_end);
+        renderer.Render();
+
+        // the unit, then its pixels row by row
+        const auto& pixels = renderer.Pixels();
+        const size_t count = size_t(unit.x1 - unit.x0) * size_t(unit.y1 - unit.y0);
+        result.resize(sizeof(WireUnit) + count * sizeof(WirePixel));
+        std::memcpy(result.data(), &unit, sizeof(unit));
+        WirePixel* out = reinterpret_cast<WirePixel*>(result.data() + sizeof(WireUnit));
+        for (int y = unit.y0; y < unit.y1; ++y) {
+            for (int x = unit.x0; x < unit.x1; ++x) {
+                const integrator::PixelState& ps = pixels[size_t(y) * width + x];
+                WirePixel& w = *out++;
+                for (int c = 0; c < 3; ++c) {
+                    w.sum[c] = ps.sum[c];
+                    w.mean[c] = ps.mean[c];
+                    w.m2[c] = ps.m2[c];
+                }
+                w.samples = uint32_t(ps.samples);
+                w.converged = ps.converged;
+            }
+        }
+        if (!SendMessage(fd, MessageType::kResult, result.data(), result.size()))
+            break;
+        ++units;
+    }
+
+    close(fd);
+    std::clog << "Worker: " << units << " units in " << std::setprecision(3) << clock.elapsed() << "s\n";
+    return type == MessageType::kDone;
+}
+
+}  // namespace rt::server
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "scene/camera.h"
+
+#include <string>
+
+namespace rt::server {
+
+struct CoordinatorOptions {
+    int         port = 7878;
+    std::string scene_path;         // must resolve on every worker
+    scene::CameraConfig camera;
+    std::string output;
+    int         tile_size = 64;
+    int         sample_splits = 1;  // sample ranges per tile, >1 spreads small frames wider
+};
+
+// Distributed rendering over TCP.
+//
+// The coordinator cuts the frame into work units (a tile and a range of
+// sample indices) and hands them out on request. Workers connect, load the
+// scene once and pull one unit after another, so fast machines simply take
+// more. Each unit comes back as the tile's PixelState (sum, mean, M2 and
+// sample count per pixel), and the coordinator merges them into the frame;
+// because random numbers are keyed by pixel and sample index, the result
+// matches a local render. That holds for sample_splits == 1 only: a sample
+// range starts from empty statistics, so its adaptive test stops on its own
+// samples and split pixels end with other sample counts. Units of a worker
+// that disconnects are handed out again.
+//
+// Messages are framed binary in host byte order, so all machines must share
+// an architecture.
+
+// Returns false if the port cannot be opened or the image cannot be written.
+bool RunCoordinator(const CoordinatorOptions& options);
+
+// "host:port"; returns false on connection or scene errors.
+bool RunWorker(const std::string& address);
+
+}  // namespace rt::server